@@ -0,0 +1,267 @@
+/*
+ * This file is part of hildon-status-menu
+ * 
+ * Copyright (C) 2010 Nokia Corporation.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * version 2.1 as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ */
+
+/* Microbenchmark of the Status Area and Status Menu boxes with dummy
+ * children, from 10 to 10000 children. One line per box, operation and
+ * number of children with the nanoseconds per operation:
+ *
+ *   pack      packing a child at a random position
+ *   reorder   moving a child to a random position
+ *   reorder-all  reordering all children at once, per child
+ *   request   size_request of the box (the children requisitions cached)
+ *   allocate  size_allocate of the box and its children
+ *   remove    removing a child, in random order
+ *
+ * The positions come from a fixed seed, so runs are comparable. Needs an
+ * X display (e.g. run with xvfb-run). */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <gtk/gtk.h>
+
+#include <stdlib.h>
+
+#include "hd-metrics.h"
+#include "hd-status-area-box.h"
+#include "hd-status-menu-box.h"
+
+#define SEED 4711
+
+/* Operations timed for the size request and allocation */
+#define SIZE_OPERATIONS 100000
+
+#define CHILD_SIZE 18
+
+typedef struct _BenchBox BenchBox;
+struct _BenchBox
+{
+  const gchar *name;
+
+  GtkWidget *(*new)      (void);
+  void       (*pack)     (GtkWidget *box,
+                          GtkWidget *child,
+                          guint      position);
+  void       (*reorder)  (GtkWidget *box,
+                          GtkWidget *child,
+                          guint      position);
+  void       (*reorder_all) (GtkWidget *box,
+                             GRand     *rand);
+};
+
+static const guint n_children[] = { 10, 100, 1000, 10000 };
+
+static guint
+random_position (GtkWidget *child,
+                 gpointer   data)
+{
+  return g_rand_int (data);
+}
+
+static void
+area_pack (GtkWidget *box,
+           GtkWidget *child,
+           guint      position)
+{
+  hd_status_area_box_pack (HD_STATUS_AREA_BOX (box), child, position);
+}
+
+static void
+area_reorder (GtkWidget *box,
+              GtkWidget *child,
+              guint      position)
+{
+  hd_status_area_box_reorder_child (HD_STATUS_AREA_BOX (box), child, position);
+}
+
+static void
+area_reorder_all (GtkWidget *box,
+                  GRand     *rand)
+{
+  hd_status_area_box_reorder_children (HD_STATUS_AREA_BOX (box),
+                                       random_position,
+                                       rand);
+}
+
+static void
+menu_pack (GtkWidget *box,
+           GtkWidget *child,
+           guint      position)
+{
+  hd_status_menu_box_pack (HD_STATUS_MENU_BOX (box), child, position);
+}
+
+static void
+menu_reorder (GtkWidget *box,
+              GtkWidget *child,
+              guint      position)
+{
+  hd_status_menu_box_reorder_child (HD_STATUS_MENU_BOX (box), child, position);
+}
+
+static void
+menu_reorder_all (GtkWidget *box,
+                  GRand     *rand)
+{
+  hd_status_menu_box_reorder_children (HD_STATUS_MENU_BOX (box),
+                                       random_position,
+                                       rand);
+}
+
+static const BenchBox boxes[] =
+{
+  { "area", hd_status_area_box_new, area_pack, area_reorder, area_reorder_all },
+  { "menu", hd_status_menu_box_new, menu_pack, menu_reorder, menu_reorder_all }
+};
+
+static guint64 start_time;
+
+static void
+start (void)
+{
+  start_time = hd_metrics_get_time ();
+}
+
+static void
+report (const BenchBox *bench,
+        const gchar    *operation,
+        guint           n,
+        guint           n_operations)
+{
+  guint64 usec = hd_metrics_get_time () - start_time;
+
+  g_print ("%-4s %-11s %6u %12.1f\n",
+           bench->name, operation, n, usec * 1000.0 / n_operations);
+}
+
+static void
+shuffle (GPtrArray *array,
+         GRand     *rand)
+{
+  guint i;
+
+  for (i = array->len; i > 1; i--)
+    {
+      guint j = g_rand_int_range (rand, 0, i);
+      gpointer tmp = array->pdata[i - 1];
+
+      array->pdata[i - 1] = array->pdata[j];
+      array->pdata[j] = tmp;
+    }
+}
+
+static void
+run (const BenchBox *bench,
+     guint           n)
+{
+  GtkWidget *window, *box;
+  GPtrArray *children;
+  GtkRequisition requisition;
+  GtkAllocation allocation;
+  GRand *rand;
+  guint i, n_size;
+
+  rand = g_rand_new_with_seed (SEED);
+
+  /* The window is not shown, the box is visible but not mapped */
+  window = gtk_window_new (GTK_WINDOW_TOPLEVEL);
+  box = bench->new ();
+  gtk_container_add (GTK_CONTAINER (window), box);
+  gtk_widget_show (box);
+
+  children = g_ptr_array_sized_new (n);
+  for (i = 0; i < n; i++)
+    {
+      GtkWidget *child = gtk_drawing_area_new ();
+
+      gtk_widget_set_size_request (child, CHILD_SIZE, CHILD_SIZE);
+      gtk_widget_show (child);
+      g_ptr_array_add (children, g_object_ref_sink (child));
+    }
+
+  start ();
+  for (i = 0; i < n; i++)
+    bench->pack (box, children->pdata[i], g_rand_int (rand));
+  report (bench, "pack", n, n);
+
+  start ();
+  for (i = 0; i < n; i++)
+    bench->reorder (box, children->pdata[g_rand_int_range (rand, 0, n)],
+                    g_rand_int (rand));
+  report (bench, "reorder", n, n);
+
+  start ();
+  bench->reorder_all (box, rand);
+  report (bench, "reorder-all", n, n);
+
+  /* Calls the class functions directly, gtk_widget_size_request would
+   * only return the cached requisition */
+  n_size = MAX (SIZE_OPERATIONS / n, 10);
+
+  start ();
+  for (i = 0; i < n_size; i++)
+    GTK_WIDGET_GET_CLASS (box)->size_request (box, &requisition);
+  report (bench, "request", n, n_size);
+
+  allocation.x = allocation.y = 0;
+  allocation.width = requisition.width;
+  allocation.height = requisition.height;
+
+  start ();
+  for (i = 0; i < n_size; i++)
+    GTK_WIDGET_GET_CLASS (box)->size_allocate (box, &allocation);
+  report (bench, "allocate", n, n_size);
+
+  shuffle (children, rand);
+
+  start ();
+  for (i = 0; i < n; i++)
+    gtk_container_remove (GTK_CONTAINER (box), children->pdata[i]);
+  report (bench, "remove", n, n);
+
+  for (i = 0; i < n; i++)
+    g_object_unref (children->pdata[i]);
+  g_ptr_array_free (children, TRUE);
+
+  gtk_widget_destroy (window);
+  g_rand_free (rand);
+}
+
+int
+main (int argc, char **argv)
+{
+  guint i, j;
+
+  if (!gtk_init_check (&argc, &argv))
+    {
+      g_printerr ("No X display\n");
+      return EXIT_FAILURE;
+    }
+
+  g_print ("# box operation children ns-per-op\n");
+
+  for (i = 0; i < G_N_ELEMENTS (boxes); i++)
+    for (j = 0; j < G_N_ELEMENTS (n_children); j++)
+      run (&boxes[i], n_children[j]);
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,185 @@
+/*
+ * This file is part of hildon-status-menu
+ * 
+ * Copyright (C) 2010 Nokia Corporation.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * version 2.1 as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ */
+
+/* Measures the cost of Status Area icon changes: N synthetic plugins
+ * (see hd-stub-plugin-manager.c) show and hide their icons in turn, and
+ * each change is followed until the Status Area is laid out, painted
+ * and the X server processed the requests. One line per N:
+ *
+ *   plugins changes wall-us cpu-us relayouts exposes x-requests
+ *
+ * with the wall clock and main thread CPU time, HDStatusAreaBox
+ * allocations, Status Area exposes and X requests per change, to compare
+ * across releases. Needs an X display (e.g. run with xvfb-run).
+ *
+ *   bench-icon-churn [changes] */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <hildon/hildon.h>
+#include <gdk/gdkx.h>
+
+#include <stdlib.h>
+
+#include "hd-metrics.h"
+#include "hd-status-area.h"
+#include "hd-status-menu-config.h"
+#include "hd-stub-plugin-manager.h"
+
+#define DEFAULT_CHANGES 2000
+
+static const guint n_plugins[] = { 1, 5, 10, 20, 50, 100 };
+
+static gchar *
+create_script (guint n)
+{
+  GString *script;
+  guint i;
+
+  script = g_string_new (NULL);
+
+  for (i = 0; i < n; i++)
+    g_string_append_printf (script,
+                            "[icon-%u.desktop]\n"
+                            HD_STATUS_AREA_CONFIG_KEY_POSITION "=%u\n"
+                            "X-Stub-Icon=general_add\n",
+                            i, i);
+
+  return g_string_free (script, FALSE);
+}
+
+/* Runs the main loop until nothing is pending, including the resize and
+ * redraw idles, and waits for the X server */
+static void
+flush (void)
+{
+  while (g_main_context_pending (NULL))
+    g_main_context_iteration (NULL, FALSE);
+
+  gdk_window_process_all_updates ();
+  gdk_display_sync (gdk_display_get_default ());
+}
+
+static gulong
+get_x_requests (void)
+{
+  return NextRequest (GDK_DISPLAY_XDISPLAY (gdk_display_get_default ()));
+}
+
+static gboolean
+run (guint n,
+     guint n_changes)
+{
+  HDStubPluginManager *plugin_manager;
+  GtkWidget *status_area;
+  guint64 wall, cpu, relayouts, exposes;
+  gulong x_requests;
+  gchar *script, *plugin_id;
+  GError *error = NULL;
+  guint i;
+
+  plugin_manager = hd_stub_plugin_manager_new ();
+
+  script = create_script (n);
+  if (!hd_stub_plugin_manager_load_data (plugin_manager, script, &error))
+    {
+      g_printerr ("Could not load the plugin script. %s\n", error->message);
+      g_error_free (error);
+      g_free (script);
+      g_object_unref (plugin_manager);
+      return FALSE;
+    }
+  g_free (script);
+
+  status_area = hd_status_area_new (G_OBJECT (plugin_manager));
+  gtk_widget_show (status_area);
+
+  hd_stub_plugin_manager_run (plugin_manager);
+  flush ();
+
+  wall = hd_metrics_get_time ();
+  cpu = hd_metrics_get_cpu_time ();
+  relayouts = hd_metrics_counter_get (HD_METRICS_AREA_RELAYOUTS);
+  exposes = hd_metrics_counter_get (HD_METRICS_AREA_EXPOSES);
+  x_requests = get_x_requests ();
+
+  /* Every plugin hides its icon, then shows it again, and so on */
+  for (i = 0; i < n_changes; i++)
+    {
+      plugin_id = g_strdup_printf ("icon-%u.desktop", i % n);
+      hd_stub_plugin_manager_set_icon_shown (plugin_manager, plugin_id,
+                                             (i / n) % 2);
+      g_free (plugin_id);
+
+      flush ();
+    }
+
+  wall = hd_metrics_get_time () - wall;
+  cpu = hd_metrics_get_cpu_time () - cpu;
+  relayouts = hd_metrics_counter_get (HD_METRICS_AREA_RELAYOUTS) - relayouts;
+  exposes = hd_metrics_counter_get (HD_METRICS_AREA_EXPOSES) - exposes;
+  x_requests = get_x_requests () - x_requests;
+
+  g_print ("%7u %7u %7.1f %7.1f %9.2f %7.2f %10.2f\n",
+           n, n_changes,
+           (gdouble) wall / n_changes,
+           (gdouble) cpu / n_changes,
+           (gdouble) relayouts / n_changes,
+           (gdouble) exposes / n_changes,
+           (gdouble) x_requests / n_changes);
+
+  gtk_widget_destroy (status_area);
+  g_object_unref (plugin_manager);
+
+  return TRUE;
+}
+
+int
+main (int argc, char **argv)
+{
+  guint n_changes = DEFAULT_CHANGES;
+  guint i;
+
+#if !GLIB_CHECK_VERSION(2,32,0)
+  if (!g_thread_supported ())
+    g_thread_init (NULL);
+#endif
+
+  if (!gtk_init_check (&argc, &argv))
+    {
+      g_printerr ("No X display\n");
+      return EXIT_FAILURE;
+    }
+  hildon_init ();
+
+  if (argc > 1)
+    n_changes = MAX (atoi (argv[1]), 1);
+
+  g_print ("# plugins changes wall-us  cpu-us relayouts exposes x-requests\n");
+
+  for (i = 0; i < G_N_ELEMENTS (n_plugins); i++)
+    if (!run (n_plugins[i], n_changes))
+      return EXIT_FAILURE;
+
+  return EXIT_SUCCESS;
+}
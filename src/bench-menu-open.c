@@ -0,0 +1,641 @@
+/*
+ * This file is part of hildon-status-menu
+ * 
+ * Copyright (C) 2010 Nokia Corporation.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * version 2.1 as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ */
+
+/* Measures how long the Status Menu takes to open, from the tap on the
+ * Status Area to the first painted frame of the menu, as seen from
+ * outside the process. For each orientation a Xvfb is started (800x480
+ * and 480x800) and for each number of menu items hildon-status-menu is
+ * run with a plugin script of synthetic items (see
+ * hd-stub-plugin-manager.c). The Status Area is tapped with XTest, the
+ * map of the menu is detected with SubstructureNotify on the root window
+ * and its first paint with XDamage, then the menu is closed with
+ * WM_DELETE_WINDOW. One line per orientation and number of items:
+ *
+ *   orientation items opens map-p50 map-p95 map-p99 frame-p50 frame-p95 frame-p99
+ *
+ * in microseconds. Needs Xvfb in the PATH.
+ *
+ *   bench-menu-open [opens [hildon-status-menu binary]] */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <glib.h>
+#include <glib/gstdio.h>
+
+#include <X11/Xlib.h>
+#include <X11/Xatom.h>
+#include <X11/extensions/Xdamage.h>
+#include <X11/extensions/XTest.h>
+
+#include <errno.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "hd-status-menu-config.h"
+
+#define DEFAULT_OPENS  100
+#define DEFAULT_BINARY "./hildon-status-menu"
+
+/* Opens not counted, the first ones load the theme and create the
+ * menu window */
+#define WARMUP_OPENS 3
+
+#define FIRST_DISPLAY 90
+#define N_DISPLAYS    100
+
+/* Times in microseconds */
+#define START_TIMEOUT (10 * G_USEC_PER_SEC)
+#define SETTLE_TIME   (2 * G_USEC_PER_SEC)
+#define OPEN_TIMEOUT  (5 * G_USEC_PER_SEC)
+#define PAUSE_TIME    (200 * 1000)
+
+typedef struct _Orientation Orientation;
+struct _Orientation
+{
+  const gchar *name;
+  guint        width;
+  guint        height;
+};
+
+static const Orientation orientations[] =
+{
+  { "landscape", 800, 480 },
+  { "portrait", 480, 800 }
+};
+
+static const guint n_items[] = { 1, 10, 30, 60 };
+
+/* A toplevel window of hildon-status-menu */
+typedef struct _Toplevel Toplevel;
+struct _Toplevel
+{
+  Damage damage;
+  Atom   type;
+};
+
+typedef struct _Bench Bench;
+struct _Bench
+{
+  Display    *display;
+  Window      root;
+  int         damage_event;
+
+  Atom        type_atom;
+  Atom        area_type;
+  Atom        menu_type;
+  Atom        protocols_atom;
+  Atom        delete_atom;
+
+  GHashTable *toplevels;
+
+  Window      area;
+  Window      menu;
+  gboolean    menu_mapped;
+
+  /* Times of the map of the menu and of its first paint */
+  guint64     map_time;
+  guint64     frame_time;
+
+  /* Reads from the connection, the damage of the background cleared
+   * by the server comes in the same read as the map */
+  guint       n_reads;
+  guint       map_read;
+};
+
+static guint64
+get_time (void)
+{
+  struct timespec ts;
+
+  clock_gettime (CLOCK_MONOTONIC, &ts);
+
+  return (guint64) ts.tv_sec * G_USEC_PER_SEC + ts.tv_nsec / 1000;
+}
+
+static int
+ignore_x_error (Display     *display,
+                XErrorEvent *event)
+{
+  /* The windows of hildon-status-menu can go away at any time */
+  return 0;
+}
+
+static gchar *
+create_script (guint n)
+{
+  GString *script;
+  guint i;
+
+  script = g_string_new (NULL);
+
+  for (i = 0; i < n; i++)
+    g_string_append_printf (script,
+                            "[item-%u.desktop]\n"
+                            HD_STATUS_MENU_CONFIG_KEY_POSITION "=%u\n"
+                            "X-Stub-Type=status-menu\n",
+                            i, i);
+
+  return g_string_free (script, FALSE);
+}
+
+static void
+stop_process (GPid pid)
+{
+  kill (pid, SIGTERM);
+  waitpid (pid, NULL, 0);
+  g_spawn_close_pid (pid);
+}
+
+/* Starts a Xvfb on the first free display and connects to it */
+static GPid
+start_xvfb (const Orientation  *orientation,
+            Display           **display)
+{
+  guint n;
+
+  for (n = FIRST_DISPLAY; n < FIRST_DISPLAY + N_DISPLAYS; n++)
+    {
+      gchar *lock, *name, *screen;
+      gchar *argv[] = { "Xvfb", NULL, "-screen", "0", NULL,
+                        "-nolisten", "tcp", NULL };
+      GPid pid;
+      guint64 deadline;
+      GError *error = NULL;
+
+      lock = g_strdup_printf ("/tmp/.X%u-lock", n);
+      if (g_file_test (lock, G_FILE_TEST_EXISTS))
+        {
+          g_free (lock);
+          continue;
+        }
+      g_free (lock);
+
+      name = g_strdup_printf (":%u", n);
+      screen = g_strdup_printf ("%ux%ux24",
+                                orientation->width, orientation->height);
+      argv[1] = name;
+      argv[4] = screen;
+
+      if (!g_spawn_async (NULL, argv, NULL,
+                          G_SPAWN_SEARCH_PATH | G_SPAWN_DO_NOT_REAP_CHILD |
+                          G_SPAWN_STDOUT_TO_DEV_NULL |
+                          G_SPAWN_STDERR_TO_DEV_NULL,
+                          NULL, NULL, &pid, &error))
+        {
+          g_printerr ("Could not start Xvfb. %s\n", error->message);
+          g_error_free (error);
+          g_free (name);
+          g_free (screen);
+          return 0;
+        }
+
+      deadline = get_time () + START_TIMEOUT;
+      *display = NULL;
+
+      /* Xvfb exits if another server took the display meanwhile */
+      while (!*display && get_time () < deadline &&
+             waitpid (pid, NULL, WNOHANG) == 0)
+        {
+          *display = XOpenDisplay (name);
+          if (!*display)
+            g_usleep (50 * 1000);
+        }
+
+      if (*display)
+        g_setenv ("DISPLAY", name, TRUE);
+      else
+        stop_process (pid);
+
+      g_free (name);
+      g_free (screen);
+
+      if (*display)
+        return pid;
+    }
+
+  g_printerr ("Could not start Xvfb on a free display\n");
+
+  return 0;
+}
+
+static Atom
+get_window_type (Bench  *bench,
+                 Window  window)
+{
+  Atom actual_type, type = None;
+  int actual_format;
+  unsigned long n, bytes_after;
+  unsigned char *data = NULL;
+
+  if (XGetWindowProperty (bench->display, window, bench->type_atom,
+                          0, 1, False, XA_ATOM, &actual_type, &actual_format,
+                          &n, &bytes_after, &data) == Success &&
+      data && n == 1 && actual_format == 32)
+    type = *((Atom *) data);
+
+  if (data)
+    XFree (data);
+
+  return type;
+}
+
+static void
+handle_event (Bench  *bench,
+              XEvent *event)
+{
+  Toplevel *toplevel;
+
+  if (event->type == bench->damage_event + XDamageNotify)
+    {
+      XDamageNotifyEvent *damage = (XDamageNotifyEvent *) event;
+
+      XDamageSubtract (bench->display, damage->damage, None, None);
+
+      if (damage->drawable == bench->menu && bench->menu_mapped &&
+          !bench->frame_time && bench->n_reads != bench->map_read)
+        bench->frame_time = get_time ();
+
+      return;
+    }
+
+  switch (event->type)
+    {
+    case CreateNotify:
+      if (event->xcreatewindow.parent != bench->root)
+        break;
+
+      /* The damage is created before the window is mapped, not to miss
+       * its first paint */
+      toplevel = g_new0 (Toplevel, 1);
+      toplevel->damage = XDamageCreate (bench->display,
+                                        event->xcreatewindow.window,
+                                        XDamageReportNonEmpty);
+      XSelectInput (bench->display, event->xcreatewindow.window,
+                    PropertyChangeMask);
+      toplevel->type = get_window_type (bench, event->xcreatewindow.window);
+      g_hash_table_insert (bench->toplevels,
+                           GUINT_TO_POINTER (event->xcreatewindow.window),
+                           toplevel);
+      break;
+
+    case DestroyNotify:
+      /* The server frees the damage with the window */
+      g_hash_table_remove (bench->toplevels,
+                           GUINT_TO_POINTER (event->xdestroywindow.window));
+      if (event->xdestroywindow.window == bench->menu)
+        {
+          bench->menu = None;
+          bench->menu_mapped = FALSE;
+        }
+      break;
+
+    case PropertyNotify:
+      toplevel = g_hash_table_lookup (bench->toplevels,
+                                      GUINT_TO_POINTER (event->xproperty.window));
+      if (toplevel && event->xproperty.atom == bench->type_atom)
+        toplevel->type = get_window_type (bench, event->xproperty.window);
+      break;
+
+    case MapNotify:
+      /* No round trips here, they would read the paint of the menu
+       * together with the map */
+      toplevel = g_hash_table_lookup (bench->toplevels,
+                                      GUINT_TO_POINTER (event->xmap.window));
+      if (!toplevel)
+        break;
+
+      if (toplevel->type == bench->area_type)
+        bench->area = event->xmap.window;
+      else if (toplevel->type == bench->menu_type)
+        {
+          bench->menu = event->xmap.window;
+          bench->menu_mapped = TRUE;
+          bench->map_time = get_time ();
+          bench->map_read = bench->n_reads;
+        }
+      break;
+
+    case UnmapNotify:
+      if (event->xunmap.window == bench->menu)
+        bench->menu_mapped = FALSE;
+      break;
+
+    default:
+      break;
+    }
+}
+
+/* Handles the next event, waiting for it until @deadline. Returns
+ * %FALSE if there was none */
+static gboolean
+dispatch (Bench   *bench,
+          guint64  deadline)
+{
+  XEvent event;
+
+  while (!XEventsQueued (bench->display, QueuedAlready))
+    {
+      struct pollfd pfd;
+      guint64 now = get_time ();
+
+      if (XEventsQueued (bench->display, QueuedAfterFlush))
+        {
+          bench->n_reads++;
+          break;
+        }
+
+      if (now >= deadline)
+        return FALSE;
+
+      pfd.fd = ConnectionNumber (bench->display);
+      pfd.events = POLLIN;
+      pfd.revents = 0;
+
+      if (poll (&pfd, 1, (deadline - now + 999) / 1000) < 0 && errno != EINTR)
+        return FALSE;
+    }
+
+  XNextEvent (bench->display, &event);
+  handle_event (bench, &event);
+
+  return TRUE;
+}
+
+/* Handles all events until @deadline */
+static void
+dispatch_until (Bench   *bench,
+                guint64  deadline)
+{
+  while (get_time () < deadline)
+    dispatch (bench, deadline);
+}
+
+static void
+close_menu (Bench *bench)
+{
+  XEvent event;
+
+  memset (&event, 0, sizeof (event));
+  event.xclient.type = ClientMessage;
+  event.xclient.window = bench->menu;
+  event.xclient.message_type = bench->protocols_atom;
+  event.xclient.format = 32;
+  event.xclient.data.l[0] = bench->delete_atom;
+  event.xclient.data.l[1] = CurrentTime;
+
+  XSendEvent (bench->display, bench->menu, False, NoEventMask, &event);
+  XFlush (bench->display);
+}
+
+/* Taps the Status Area and waits for the menu to be mapped and painted.
+ * The times are from the press */
+static gboolean
+open_menu (Bench   *bench,
+           guint64 *map_latency,
+           guint64 *frame_latency)
+{
+  guint64 start, deadline;
+
+  bench->frame_time = 0;
+
+  start = get_time ();
+  deadline = start + OPEN_TIMEOUT;
+
+  XTestFakeButtonEvent (bench->display, 1, True, CurrentTime);
+  XTestFakeButtonEvent (bench->display, 1, False, CurrentTime);
+  XFlush (bench->display);
+
+  while (!(bench->menu_mapped && bench->frame_time))
+    if (!dispatch (bench, deadline))
+      return FALSE;
+
+  *map_latency = bench->map_time - start;
+  *frame_latency = bench->frame_time - start;
+
+  close_menu (bench);
+
+  while (bench->menu_mapped)
+    if (!dispatch (bench, deadline))
+      return FALSE;
+
+  /* Let the menu idle again before the next tap */
+  dispatch_until (bench, get_time () + PAUSE_TIME);
+
+  return TRUE;
+}
+
+static int
+cmp_latency (gconstpointer a,
+             gconstpointer b)
+{
+  guint64 x = *((const guint64 *) a);
+  guint64 y = *((const guint64 *) b);
+
+  return x < y ? -1 : (x > y ? 1 : 0);
+}
+
+/* Nearest rank, @latencies sorted */
+static guint64
+percentile (GArray *latencies,
+            guint   p)
+{
+  guint rank = (p * latencies->len + 99) / 100;
+
+  return g_array_index (latencies, guint64, MAX (rank, 1) - 1);
+}
+
+static gboolean
+run (const Orientation *orientation,
+     guint              n,
+     guint              n_opens,
+     const gchar       *binary)
+{
+  Bench bench;
+  gchar *script, *filename;
+  gchar *argv[] = { NULL, NULL };
+  GPid xvfb, status_menu = 0;
+  GArray *map_latencies, *frame_latencies;
+  int damage_error, tmp;
+  Window child;
+  int x, y;
+  unsigned int width, height, border, depth;
+  guint i;
+  gboolean success = FALSE;
+  GError *error = NULL;
+
+  memset (&bench, 0, sizeof (bench));
+
+  xvfb = start_xvfb (orientation, &bench.display);
+  if (!xvfb)
+    return FALSE;
+
+  XSetErrorHandler (ignore_x_error);
+
+  map_latencies = g_array_new (FALSE, FALSE, sizeof (guint64));
+  frame_latencies = g_array_new (FALSE, FALSE, sizeof (guint64));
+  bench.toplevels = g_hash_table_new_full (NULL, NULL, NULL,
+                                           (GDestroyNotify) g_free);
+
+  if (!XDamageQueryExtension (bench.display, &bench.damage_event,
+                              &damage_error) ||
+      !XTestQueryExtension (bench.display, &tmp, &tmp, &tmp, &tmp))
+    {
+      g_printerr ("Xvfb has no DAMAGE or XTEST extension\n");
+      goto out;
+    }
+
+  bench.root = DefaultRootWindow (bench.display);
+  bench.type_atom = XInternAtom (bench.display, "_NET_WM_WINDOW_TYPE", False);
+  bench.area_type = XInternAtom (bench.display,
+                                 "_HILDON_WM_WINDOW_TYPE_STATUS_AREA", False);
+  bench.menu_type = XInternAtom (bench.display,
+                                 "_HILDON_WM_WINDOW_TYPE_STATUS_MENU", False);
+  bench.protocols_atom = XInternAtom (bench.display, "WM_PROTOCOLS", False);
+  bench.delete_atom = XInternAtom (bench.display, "WM_DELETE_WINDOW", False);
+
+  XSelectInput (bench.display, bench.root, SubstructureNotifyMask);
+  XSync (bench.display, False);
+
+  script = create_script (n);
+  tmp = g_file_open_tmp ("bench-menu-open-XXXXXX.plugins", &filename, &error);
+  if (tmp < 0)
+    {
+      g_printerr ("Could not write the plugin script. %s\n", error->message);
+      g_error_free (error);
+      g_free (script);
+      goto out;
+    }
+  close (tmp);
+
+  if (!g_file_set_contents (filename, script, -1, &error))
+    {
+      g_printerr ("Could not write the plugin script. %s\n", error->message);
+      g_error_free (error);
+      g_free (script);
+      goto out_script;
+    }
+  g_free (script);
+
+  g_setenv ("HD_STATUS_MENU_PLUGIN_SCRIPT", filename, TRUE);
+
+  argv[0] = (gchar *) binary;
+  if (!g_spawn_async (NULL, argv, NULL, G_SPAWN_DO_NOT_REAP_CHILD,
+                      NULL, NULL, &status_menu, &error))
+    {
+      g_printerr ("Could not start %s. %s\n", binary, error->message);
+      g_error_free (error);
+      status_menu = 0;
+      goto out_script;
+    }
+
+  while (!bench.area)
+    if (!dispatch (&bench, get_time () + START_TIMEOUT))
+      {
+        g_printerr ("The Status Area was not shown\n");
+        goto out_script;
+      }
+
+  /* Let the items be added */
+  dispatch_until (&bench, get_time () + SETTLE_TIME);
+
+  XGetGeometry (bench.display, bench.area, &child, &x, &y,
+                &width, &height, &border, &depth);
+  XTranslateCoordinates (bench.display, bench.area, bench.root,
+                         width / 2, height / 2, &x, &y, &child);
+  XTestFakeMotionEvent (bench.display, -1, x, y, CurrentTime);
+
+  for (i = 0; i < WARMUP_OPENS + n_opens; i++)
+    {
+      guint64 map_latency, frame_latency;
+
+      if (!open_menu (&bench, &map_latency, &frame_latency))
+        {
+          g_printerr ("The Status Menu was not shown and painted\n");
+          goto out_script;
+        }
+
+      if (i >= WARMUP_OPENS)
+        {
+          g_array_append_val (map_latencies, map_latency);
+          g_array_append_val (frame_latencies, frame_latency);
+        }
+    }
+
+  g_array_sort (map_latencies, cmp_latency);
+  g_array_sort (frame_latencies, cmp_latency);
+
+  g_print ("%-11s %5u %5u %7" G_GUINT64_FORMAT " %7" G_GUINT64_FORMAT
+           " %7" G_GUINT64_FORMAT " %9" G_GUINT64_FORMAT
+           " %9" G_GUINT64_FORMAT " %9" G_GUINT64_FORMAT "\n",
+           orientation->name, n, n_opens,
+           percentile (map_latencies, 50),
+           percentile (map_latencies, 95),
+           percentile (map_latencies, 99),
+           percentile (frame_latencies, 50),
+           percentile (frame_latencies, 95),
+           percentile (frame_latencies, 99));
+
+  success = TRUE;
+
+out_script:
+  if (status_menu)
+    stop_process (status_menu);
+  g_unlink (filename);
+  g_free (filename);
+
+out:
+  g_hash_table_destroy (bench.toplevels);
+  g_array_free (map_latencies, TRUE);
+  g_array_free (frame_latencies, TRUE);
+  XCloseDisplay (bench.display);
+  stop_process (xvfb);
+
+  return success;
+}
+
+int
+main (int argc, char **argv)
+{
+  const gchar *binary = DEFAULT_BINARY;
+  guint n_opens = DEFAULT_OPENS;
+  guint i, j;
+
+  if (argc > 1)
+    n_opens = MAX (atoi (argv[1]), 1);
+  if (argc > 2)
+    binary = argv[2];
+
+  g_print ("# orientation items opens map-p50 map-p95 map-p99 frame-p50 frame-p95 frame-p99\n");
+
+  for (i = 0; i < G_N_ELEMENTS (orientations); i++)
+    for (j = 0; j < G_N_ELEMENTS (n_items); j++)
+      if (!run (&orientations[i], n_items[j], n_opens, binary))
+        return EXIT_FAILURE;
+
+  return EXIT_SUCCESS;
+}
@@ -27,6 +27,8 @@
 #include <gdk/gdkx.h>
 
 #include "hd-desktop.h"
+#include "hd-trace.h"
+#include "hd-x-audit.h"
 
 #define HD_DESKTOP_GET_PRIVATE(object) \
   (G_TYPE_INSTANCE_GET_PRIVATE ((object), HD_TYPE_DESKTOP, HDDesktopPrivate))
@@ -142,43 +144,32 @@ filter_property_changed (GdkXEvent *xevent,
           int actual_format;
           unsigned long nitems, bytes;
           unsigned char *atom_data = NULL;
-
-          if (XGetWindowProperty (GDK_WINDOW_XDISPLAY (priv->root_window),
-                                  GDK_WINDOW_XID (priv->root_window),
-                                  gdk_x11_get_xatom_by_name ("_MB_CURRENT_APP_WINDOW"),
-                                  0,
-                                  (~0L),
-                                  False,
-                                  AnyPropertyType,
-                                  &actual_type,
-                                  &actual_format,
-                                  &nitems,
-                                  &bytes,
-                                  &atom_data) == Success)
+          gulong mark;
+          int result;
+
+          mark = hd_x_audit_mark ();
+          result = XGetWindowProperty (GDK_WINDOW_XDISPLAY (priv->root_window),
+                                       GDK_WINDOW_XID (priv->root_window),
+                                       gdk_x11_get_xatom_by_name ("_MB_CURRENT_APP_WINDOW"),
+                                       0,
+                                       (~0L),
+                                       False,
+                                       AnyPropertyType,
+                                       &actual_type,
+                                       &actual_format,
+                                       &nitems,
+                                       &bytes,
+                                       &atom_data);
+          hd_x_audit_round_trips ("filter_property_changed", mark);
+
+          if (result == Success)
             {
               if (nitems == 1) {
                   guint32 *new_value = (void *) atom_data;
 
-                  if (*new_value == 0xFFFFFFFF)
-                    {
-                      if (!priv->task_switcher_shown)
-                        {
-                          priv->task_switcher_shown = TRUE;
-                          g_signal_emit (desktop,
-                                         desktop_signals [TASK_SWITCHER_SHOW],
-                                         0);
-                        }
-                    }
-                  else
-                    {
-                      if (priv->task_switcher_shown)
-                        {
-                          priv->task_switcher_shown = FALSE;
-                          g_signal_emit (desktop,
-                                         desktop_signals [TASK_SWITCHER_HIDE],
-                                         0);
-                        }
-                    }
+                  hd_trace_record (HD_TRACE_CURRENT_APP_WINDOW, "%u", *new_value);
+
+                  hd_desktop_set_current_app_window (desktop, *new_value);
               }
             }
 	  
@@ -202,6 +193,47 @@ hd_desktop_dispose (GObject *object)
   G_OBJECT_CLASS (hd_desktop_parent_class)->dispose (object);
 }
 
+/**
+ * hd_desktop_set_current_app_window:
+ * @desktop: a #HDDesktop
+ * @window: the value of the _MB_CURRENT_APP_WINDOW root window property
+ *
+ * Update the task switcher state from the current application window,
+ * which is 0xFFFFFFFF while the task switcher is shown. Called for each
+ * change of the property and to replay traces (see hd-trace.c).
+ **/
+void
+hd_desktop_set_current_app_window (HDDesktop *desktop,
+                                   guint32    window)
+{
+  HDDesktopPrivate *priv;
+
+  g_return_if_fail (HD_IS_DESKTOP (desktop));
+
+  priv = desktop->priv;
+
+  if (window == 0xFFFFFFFF)
+    {
+      if (!priv->task_switcher_shown)
+        {
+          priv->task_switcher_shown = TRUE;
+          g_signal_emit (desktop,
+                         desktop_signals [TASK_SWITCHER_SHOW],
+                         0);
+        }
+    }
+  else
+    {
+      if (priv->task_switcher_shown)
+        {
+          priv->task_switcher_shown = FALSE;
+          g_signal_emit (desktop,
+                         desktop_signals [TASK_SWITCHER_HIDE],
+                         0);
+        }
+    }
+}
+
 gboolean
 hd_desktop_is_task_switcher_visible (HDDesktop *desktop)
 {
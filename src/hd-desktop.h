@@ -56,6 +56,9 @@ HDDesktop *hd_desktop_get      (void);
 
 gboolean   hd_desktop_is_task_switcher_visible (HDDesktop *desktop);
 
+void       hd_desktop_set_current_app_window   (HDDesktop *desktop,
+                                                guint32    window);
+
 G_END_DECLS
 
 #endif
@@ -32,6 +32,10 @@
 #include <string.h>
 
 #include "hd-display.h"
+#include "hd-metrics.h"
+#include "hd-recorder.h"
+#include "hd-trace.h"
+#include "hd-wakeups.h"
 
 #define HD_DISPLAY_GET_PRIVATE(object) \
   (G_TYPE_INSTANCE_GET_PRIVATE ((object), HD_TYPE_DISPLAY, HDDisplayPrivate))
@@ -112,6 +116,7 @@ initialize_system_dbus (HDDisplay *display)
 {
   HDDisplayPrivate *priv = display->priv;
   DBusError error;
+  int fd;
 
   dbus_error_init (&error);
   priv->system_bus = dbus_bus_get (DBUS_BUS_SYSTEM,
@@ -132,6 +137,10 @@ initialize_system_dbus (HDDisplay *display)
                               system_bus_signal_filter,
                               display,
                               NULL);
+
+  /* MCE and DSME signals */
+  if (dbus_connection_get_unix_fd (priv->system_bus, &fd))
+    hd_wakeups_add_fd (fd, "system-bus");
 }
 
 static DBusHandlerResult
@@ -140,7 +149,9 @@ system_bus_signal_filter (DBusConnection *system_bus,
                           void           *data)
 {
   HDDisplay *display = data;
-  HDDisplayPrivate *priv = display->priv;
+  guint64 cpu_start = hd_metrics_get_cpu_time ();
+
+  hd_metrics_counter_add (HD_METRICS_DBUS_MESSAGES, 1);
 
   if (dbus_message_is_signal (msg,
                               MCE_SIGNAL_IF,
@@ -152,33 +163,70 @@ system_bus_signal_filter (DBusConnection *system_bus,
         if (dbus_message_iter_get_arg_type (&iter) == DBUS_TYPE_STRING)
           {
             const char *value;
-            gboolean display_on = TRUE;
 
             dbus_message_iter_get_basic(&iter, &value);
-            if (strcmp (value, MCE_DISPLAY_ON_STRING) == 0)
-              display_on = TRUE;
-            else if (strcmp (value, MCE_DISPLAY_DIM_STRING) == 0)
-              display_on = TRUE;
-            else if (strcmp (value, MCE_DISPLAY_OFF_STRING) == 0)
-              display_on = FALSE;
-            else
-              g_warning ("%s. Unknown value %s for signal %s.%s",
-                         __FUNCTION__,
-                         value,
-                         MCE_SIGNAL_IF,
-                         MCE_DISPLAY_SIG);
-
-            priv->display_on = display_on;
-
-            g_signal_emit (display,
-                           display_signals[DISPLAY_STATUS_CHANGED],
-                           0);
+
+            hd_trace_record (HD_TRACE_MCE_DISPLAY, "%s", value);
+
+            hd_display_set_status (display, value);
           }
      }
 
+  hd_metrics_counter_add (HD_METRICS_DBUS_FILTER_CPU,
+                          hd_metrics_get_cpu_time () - cpu_start);
+
   return DBUS_HANDLER_RESULT_NOT_YET_HANDLED;
 }
 
+/**
+ * hd_display_set_status:
+ * @display: a #HDDisplay
+ * @status: the display status as sent by MCE (on, dim or off)
+ *
+ * Update the display state. Called for each MCE display status signal
+ * and to replay traces (see hd-trace.c). ::display-status-changed is only
+ * emitted if the display was switched on or off, MCE also sends the
+ * status on dimming and repeats it.
+ **/
+void
+hd_display_set_status (HDDisplay   *display,
+                       const gchar *status)
+{
+  HDDisplayPrivate *priv;
+  gboolean display_on = TRUE;
+
+  g_return_if_fail (HD_IS_DISPLAY (display));
+  g_return_if_fail (status != NULL);
+
+  priv = display->priv;
+
+  if (strcmp (status, MCE_DISPLAY_ON_STRING) == 0)
+    display_on = TRUE;
+  else if (strcmp (status, MCE_DISPLAY_DIM_STRING) == 0)
+    display_on = TRUE;
+  else if (strcmp (status, MCE_DISPLAY_OFF_STRING) == 0)
+    display_on = FALSE;
+  else
+    g_warning ("%s. Unknown value %s for signal %s.%s",
+               __FUNCTION__,
+               status,
+               MCE_SIGNAL_IF,
+               MCE_DISPLAY_SIG);
+
+  hd_recorder_record (HD_RECORDER_DBUS_SIGNAL, display_on);
+
+  /* Dropped, so the Status Area does not re-check whether it is on
+   * screen on a repeated "on" (see display_status_changed_cb) */
+  if (priv->display_on == display_on)
+    return;
+
+  priv->display_on = display_on;
+
+  g_signal_emit (display,
+                 display_signals[DISPLAY_STATUS_CHANGED],
+                 0);
+}
+
 static void
 hd_display_dispose (GObject *object)
 {
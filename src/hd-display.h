@@ -56,6 +56,9 @@ HDDisplay *hd_display_get        (void);
 
 gboolean   hd_display_is_on      (HDDisplay *display);
 
+void       hd_display_set_status (HDDisplay   *display,
+                                  const gchar *status);
+
 G_END_DECLS
 
 #endif
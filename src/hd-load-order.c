@@ -0,0 +1,247 @@
+/*
+ * This file is part of hildon-status-menu
+ * 
+ * Copyright (C) 2010 Nokia Corporation.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * version 2.1 as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <glib.h>
+#include <glib/gstdio.h>
+#include <libhildondesktop/libhildondesktop.h>
+
+#include "hd-load-order.h"
+#include "hd-metrics.h"
+
+/* Load costs of the plugins measured in previous runs, used to load
+ * cheap plugins which show an icon first. One group per installed plugin
+ * id with the CPU time of its construction in microseconds and whether
+ * it showed a Status Area icon in the last run. Both do not depend on
+ * the load order itself (unlike the wall clock time to the first icon,
+ * which is shorter for the plugins loaded first), so the learned order
+ * is stable. */
+#define HD_LOAD_ORDER_FILE "status-menu-load-order"
+
+#define HD_LOAD_ORDER_KEY_LOAD_TIME  "Load-Cpu-Time"
+#define HD_LOAD_ORDER_KEY_SHOWS_ICON "Shows-Icon"
+
+/* The measurements are saved this long after the plugins are loaded,
+ * to include the icons of the plugins */
+#define SAVE_DELAY 30
+
+/* Priorities of plugins which showed an icon start at 1 (permanent items
+ * have 0), of plugins which did not at KNOWN_PRIORITY, both increasing
+ * with the cost in milliseconds */
+#define KNOWN_PRIORITY (1 << 21)
+#define MAX_COST_MS    (KNOWN_PRIORITY - 2)
+
+static GKeyFile   *key_file = NULL;
+static gchar      *filename = NULL;
+
+/* Plugins added in this run, plugin id to whether it showed an icon */
+static GHashTable *added = NULL;
+
+static gboolean    loading = FALSE;
+static guint64     load_mark = 0;
+
+static GQuark      quark_hd_load_order_plugin_id = 0;
+
+void
+hd_load_order_init (void)
+{
+  if (key_file)
+    return;
+
+  quark_hd_load_order_plugin_id = g_quark_from_static_string ("hd_load_order_plugin_id");
+
+  filename = g_build_filename (g_get_user_cache_dir (), "hildon-desktop",
+                               HD_LOAD_ORDER_FILE, NULL);
+
+  key_file = g_key_file_new ();
+  g_key_file_load_from_file (key_file, filename, G_KEY_FILE_NONE, NULL);
+
+  added = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+}
+
+static guint64
+get_time (const gchar *plugin_id,
+          const gchar *key)
+{
+  gchar *value;
+  guint64 time;
+
+  value = g_key_file_get_value (key_file, plugin_id, key, NULL);
+  if (!value)
+    return G_MAXUINT64;
+
+  time = g_ascii_strtoull (value, NULL, 10);
+  g_free (value);
+
+  return time;
+}
+
+/* Averages the new measurement with the ones of previous runs */
+static void
+set_time (const gchar *plugin_id,
+          const gchar *key,
+          guint64      time)
+{
+  guint64 previous = get_time (plugin_id, key);
+  gchar *value;
+
+  if (previous != G_MAXUINT64)
+    time = (previous * 3 + time) / 4;
+
+  value = g_strdup_printf ("%" G_GUINT64_FORMAT, time);
+  g_key_file_set_value (key_file, plugin_id, key, value);
+  g_free (value);
+}
+
+/**
+ * hd_load_order_get_priority:
+ * @plugin_id: the plugin id
+ *
+ * Returns the load priority learned for the plugin: plugins which showed
+ * an icon in the last run first, then the other ones measured, each
+ * ordered by construction CPU time. Returns %G_MAXUINT if
+ * there are no measurements, the caller should use
+ * %HD_LOAD_ORDER_UNKNOWN_PRIORITY or above then.
+ **/
+guint
+hd_load_order_get_priority (const gchar *plugin_id)
+{
+  guint64 load_time;
+  guint cost;
+
+  if (!key_file)
+    return G_MAXUINT;
+
+  load_time = get_time (plugin_id, HD_LOAD_ORDER_KEY_LOAD_TIME);
+  if (load_time == G_MAXUINT64)
+    return G_MAXUINT;
+
+  cost = MIN (load_time / 1000, MAX_COST_MS);
+
+  if (!g_key_file_get_boolean (key_file, plugin_id,
+                               HD_LOAD_ORDER_KEY_SHOWS_ICON, NULL))
+    return KNOWN_PRIORITY + cost;
+
+  return 1 + cost;
+}
+
+void
+hd_load_order_load_begin (void)
+{
+  loading = TRUE;
+  hd_load_order_load_resume ();
+}
+
+/* The CPU time since the last plugin was added (or the load started) is
+ * the construction of this plugin (see hd_metrics_plugin_loaded) */
+void
+hd_load_order_plugin_added (GObject *plugin)
+{
+  gchar *plugin_id;
+  guint64 now;
+
+  if (!key_file || !HD_IS_PLUGIN_ITEM (plugin))
+    return;
+
+  now = hd_metrics_get_cpu_time ();
+  plugin_id = hd_plugin_item_get_plugin_id (HD_PLUGIN_ITEM (plugin));
+
+  if (loading)
+    set_time (plugin_id, HD_LOAD_ORDER_KEY_LOAD_TIME, now - load_mark);
+
+  if (!g_hash_table_lookup_extended (added, plugin_id, NULL, NULL))
+    g_hash_table_insert (added, g_strdup (plugin_id), GINT_TO_POINTER (FALSE));
+
+  g_object_set_qdata_full (plugin, quark_hd_load_order_plugin_id,
+                           plugin_id, g_free);
+}
+
+void
+hd_load_order_load_resume (void)
+{
+  if (loading)
+    load_mark = hd_metrics_get_cpu_time ();
+}
+
+static gboolean
+save_cb (gpointer data)
+{
+  gchar **groups, *contents, *dirname;
+  gsize length, i;
+  gpointer shows_icon;
+  GError *error = NULL;
+
+  /* Plugins not loaded in this run are uninstalled or disabled */
+  groups = g_key_file_get_groups (key_file, NULL);
+  for (i = 0; groups[i]; i++)
+    {
+      if (g_hash_table_lookup_extended (added, groups[i], NULL, &shows_icon))
+        g_key_file_set_boolean (key_file, groups[i],
+                                HD_LOAD_ORDER_KEY_SHOWS_ICON,
+                                GPOINTER_TO_INT (shows_icon));
+      else
+        g_key_file_remove_group (key_file, groups[i], NULL);
+    }
+  g_strfreev (groups);
+
+  dirname = g_path_get_dirname (filename);
+  g_mkdir_with_parents (dirname, 0755);
+  g_free (dirname);
+
+  contents = g_key_file_to_data (key_file, &length, NULL);
+  if (!g_file_set_contents (filename, contents, length, &error))
+    {
+      g_warning ("%s: could not save %s. %s",
+                 __FUNCTION__, filename, error->message);
+      g_error_free (error);
+    }
+  g_free (contents);
+
+  return FALSE;
+}
+
+void
+hd_load_order_load_end (void)
+{
+  loading = FALSE;
+
+  if (key_file)
+    g_timeout_add_seconds (SAVE_DELAY, save_cb, NULL);
+}
+
+/* Called for each Status Area icon set */
+void
+hd_load_order_icon_shown (GObject *plugin)
+{
+  const gchar *plugin_id;
+
+  if (!key_file)
+    return;
+
+  plugin_id = g_object_get_qdata (plugin, quark_hd_load_order_plugin_id);
+  if (!plugin_id)
+    return;
+
+  g_hash_table_replace (added, g_strdup (plugin_id), GINT_TO_POINTER (TRUE));
+}
@@ -0,0 +1,46 @@
+/*
+ * This file is part of hildon-status-menu
+ * 
+ * Copyright (C) 2010 Nokia Corporation.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * version 2.1 as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ */
+
+#ifndef __HD_LOAD_ORDER_H__
+#define __HD_LOAD_ORDER_H__
+
+#include <glib-object.h>
+
+G_BEGIN_DECLS
+
+/* Priorities of plugins without measurements from previous runs start
+ * here, see hd_load_order_get_priority */
+#define HD_LOAD_ORDER_UNKNOWN_PRIORITY (1 << 22)
+
+void  hd_load_order_init          (void);
+
+guint hd_load_order_get_priority  (const gchar *plugin_id);
+
+void  hd_load_order_load_begin    (void);
+void  hd_load_order_plugin_added  (GObject     *plugin);
+void  hd_load_order_load_resume   (void);
+void  hd_load_order_load_end      (void);
+
+void  hd_load_order_icon_shown    (GObject     *plugin);
+
+G_END_DECLS
+
+#endif
@@ -0,0 +1,883 @@
+/*
+ * This file is part of hildon-status-menu
+ * 
+ * Copyright (C) 2010 Nokia Corporation.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * version 2.1 as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <glib.h>
+#include <glib/gstdio.h>
+#include <gdk/gdkx.h>
+#include <dbus/dbus.h>
+#include <dbus/dbus-glib.h>
+#include <dbus/dbus-glib-lowlevel.h>
+#include <libhildondesktop/libhildondesktop.h>
+
+#include <fcntl.h>
+#include <malloc.h>
+#include <signal.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "hd-metrics.h"
+
+/* The metrics are written to this file on SIGUSR1, one "name value"
+ * pair per line. Times are in microseconds, counters are cumulative, so
+ * rates are computed from two dumps and their "time" values. */
+#define HD_METRICS_DIR  "/tmp/hildon-desktop/"
+#define HD_METRICS_FILE HD_METRICS_DIR "status-menu.metrics"
+
+/* The same metrics are returned by the GetSnapshot method as a{st} on the
+ * session bus:
+ *
+ *   dbus-send --session --print-reply --dest=com.nokia.HildonStatusMenu.Metrics \
+ *     /com/nokia/HildonStatusMenu/Metrics com.nokia.HildonStatusMenu.Metrics.GetSnapshot
+ */
+#define HD_METRICS_DBUS_NAME         "com.nokia.HildonStatusMenu.Metrics"
+#define HD_METRICS_DBUS_PATH         "/com/nokia/HildonStatusMenu/Metrics"
+#define HD_METRICS_DBUS_INTERFACE    "com.nokia.HildonStatusMenu.Metrics"
+#define HD_METRICS_DBUS_GET_SNAPSHOT "GetSnapshot"
+
+/* Number of most recent samples kept for each latency */
+#define LATENCY_SAMPLES 512
+
+typedef struct _HDMetricsLatencySeries HDMetricsLatencySeries;
+struct _HDMetricsLatencySeries
+{
+  guint64 samples[LATENCY_SAMPLES];
+  guint   n_samples;
+};
+
+static const gchar *latency_names[HD_METRICS_N_LATENCIES] =
+{
+  "menu-open-landscape",
+  "menu-open-portrait",
+  "rotation",
+  "visibility-propagation",
+  "plugin-add",
+  "plugin-remove",
+  "plugin-ready"
+};
+
+static const gchar *counter_names[HD_METRICS_N_COUNTERS] =
+{
+  "menu-opens",
+  "menu-items",
+  "icon-updates",
+  "icon-update-cpu",
+  "icon-updates-coalesced",
+  "area-relayouts",
+  "area-exposes",
+  "visibility-updates",
+  "visibility-changes",
+  "dbus-messages",
+  "dbus-filter-cpu",
+  "plugins-added",
+  "plugins-removed",
+  "area-images",
+  "window-resizes",
+  "plugins-preloaded",
+  "ready-permanent-items",
+  "ready-plugins-loaded",
+  "plugin-ready-timeouts"
+};
+
+static const gchar *plugin_cpu_names[HD_METRICS_N_PLUGIN_CPU] =
+{
+  "construct-cpu",
+  "visibility-cpu",
+  "icon-cpu",
+  "layout-cpu"
+};
+
+typedef struct _HDMetricsPlugin HDMetricsPlugin;
+struct _HDMetricsPlugin
+{
+  guint64 cpu[HD_METRICS_N_PLUGIN_CPU];
+
+  /* Memory accounting, see hd_metrics_memory_init */
+  guint64 heap_allocated;
+  guint64 heap_freed;
+  guint   n_instances;
+  gsize   icon_bytes;
+
+  /* Wall clock time of reading ahead the plugin library and its
+   * dependencies on a worker thread which the main thread did not wait
+   * for, see hd-preload.c */
+  guint64 preload_saved;
+};
+
+static HDMetricsLatencySeries latencies[HD_METRICS_N_LATENCIES];
+static guint64 counters[HD_METRICS_N_COUNTERS];
+
+/* HDMetricsPlugin by plugin id, kept after a plugin is removed */
+static GHashTable *plugins = NULL;
+
+static GQuark      quark_hd_metrics_plugin = 0;
+static const gchar hd_metrics_plugin[] = "hd_metrics_plugin";
+
+/* Handlers of the signals written to the pipe, see
+ * hd_metrics_add_signal_handler */
+#define MAX_SIGNAL_HANDLERS 4
+
+typedef struct _HDMetricsSignalHandler HDMetricsSignalHandler;
+struct _HDMetricsSignalHandler
+{
+  int                 signum;
+  HDMetricsSignalFunc func;
+};
+
+static int signal_pipe[2] = { -1, -1 };
+
+static HDMetricsSignalHandler signal_handlers[MAX_SIGNAL_HANDLERS];
+static guint                  n_signal_handlers = 0;
+
+/* Plugin loading, see hd_metrics_plugin_load_begin */
+static gboolean loading = FALSE;
+static guint64  load_cpu_mark = 0;
+static gsize    load_memory_mark = 0;
+
+/* Memory accounting, see hd_metrics_memory_init */
+static gboolean memory_accounting = FALSE;
+
+/* A removed plugin, until it is finalized */
+typedef struct _HDMetricsRemoval HDMetricsRemoval;
+struct _HDMetricsRemoval
+{
+  HDMetricsPlugin *record;
+  gsize            heap_mark;
+};
+
+static void register_dbus_object (void);
+
+static void
+signal_handler (int signal)
+{
+  guchar c = (guchar) signal;
+
+  /* Only async-signal-safe calls here, the dump itself is done
+   * from the main loop (see signal_pipe_cb) */
+  if (write (signal_pipe[1], &c, 1) < 0)
+    return;
+}
+
+static gboolean
+signal_pipe_cb (GIOChannel   *source,
+                GIOCondition  condition,
+                gpointer      data)
+{
+  guchar c;
+  guint i;
+
+  while (read (signal_pipe[0], &c, 1) == 1)
+    {
+      for (i = 0; i < n_signal_handlers; i++)
+        if (signal_handlers[i].signum == c)
+          signal_handlers[i].func ();
+    }
+
+  return TRUE;
+}
+
+void
+hd_metrics_init (void)
+{
+  GIOChannel *channel;
+
+  if (signal_pipe[0] >= 0)
+    return;
+
+  if (pipe (signal_pipe) < 0)
+    {
+      g_warning ("%s: failed to create signal pipe", __FUNCTION__);
+      return;
+    }
+
+  fcntl (signal_pipe[0], F_SETFL, O_NONBLOCK);
+  fcntl (signal_pipe[1], F_SETFL, O_NONBLOCK);
+
+  channel = g_io_channel_unix_new (signal_pipe[0]);
+  g_io_add_watch (channel, G_IO_IN, signal_pipe_cb, NULL);
+  g_io_channel_unref (channel);
+
+  hd_metrics_add_signal_handler (SIGUSR1, hd_metrics_dump);
+
+  register_dbus_object ();
+}
+
+/* Calls func from the main loop when signal signum is received.
+ * hd_metrics_init must be called first. */
+void
+hd_metrics_add_signal_handler (int                 signum,
+                               HDMetricsSignalFunc func)
+{
+  g_return_if_fail (signal_pipe[0] >= 0);
+  g_return_if_fail (signum > 0 && signum < 256);
+
+  if (n_signal_handlers == MAX_SIGNAL_HANDLERS)
+    {
+      g_warning ("%s: too many signal handlers", __FUNCTION__);
+      return;
+    }
+
+  signal_handlers[n_signal_handlers].signum = signum;
+  signal_handlers[n_signal_handlers].func = func;
+  n_signal_handlers++;
+
+  signal (signum, signal_handler);
+}
+
+guint64
+hd_metrics_get_time (void)
+{
+  struct timespec ts;
+
+  clock_gettime (CLOCK_MONOTONIC, &ts);
+
+  return (guint64) ts.tv_sec * G_USEC_PER_SEC + ts.tv_nsec / 1000;
+}
+
+/* CPU time consumed by the main thread */
+guint64
+hd_metrics_get_cpu_time (void)
+{
+  struct timespec ts;
+
+  clock_gettime (CLOCK_THREAD_CPUTIME_ID, &ts);
+
+  return (guint64) ts.tv_sec * G_USEC_PER_SEC + ts.tv_nsec / 1000;
+}
+
+void
+hd_metrics_add_latency (HDMetricsLatency latency,
+                        guint64          usec)
+{
+  HDMetricsLatencySeries *series;
+
+  g_return_if_fail (latency < HD_METRICS_N_LATENCIES);
+
+  series = &latencies[latency];
+
+  series->samples[series->n_samples % LATENCY_SAMPLES] = usec;
+  series->n_samples++;
+}
+
+void
+hd_metrics_counter_add (HDMetricsCounter counter,
+                        guint64          value)
+{
+  g_return_if_fail (counter < HD_METRICS_N_COUNTERS);
+
+  counters[counter] += value;
+}
+
+void
+hd_metrics_counter_set (HDMetricsCounter counter,
+                        guint64          value)
+{
+  g_return_if_fail (counter < HD_METRICS_N_COUNTERS);
+
+  counters[counter] = value;
+}
+
+guint64
+hd_metrics_counter_get (HDMetricsCounter counter)
+{
+  g_return_val_if_fail (counter < HD_METRICS_N_COUNTERS, 0);
+
+  return counters[counter];
+}
+
+/* Bytes in use by malloc, on the heap and in mmapped chunks, 0 if
+ * unknown */
+gsize
+hd_metrics_get_heap_in_use (void)
+{
+#if defined (HAVE_MALLINFO2)
+  struct mallinfo2 info = mallinfo2 ();
+
+  return info.uordblks + info.hblkhd;
+#elif defined (HAVE_MALLINFO)
+  struct mallinfo info = mallinfo ();
+
+  /* The int fields wrap beyond 2 GiB */
+  return (guint) info.uordblks + (guint) info.hblkhd;
+#else
+  return 0;
+#endif
+}
+
+static void
+account_heap (HDMetricsPlugin *record,
+              gsize            mark,
+              gsize            heap_in_use)
+{
+  if (heap_in_use >= mark)
+    record->heap_allocated += heap_in_use - mark;
+  else
+    record->heap_freed += mark - heap_in_use;
+}
+
+/* Optional memory accounting mode, enabled by setting the environment
+ * variable HD_STATUS_MENU_MEMORY_ACCOUNTING. Called at the start of main,
+ * as GSlice is then switched to malloc so its blocks are seen in the
+ * heap.
+ *
+ * The malloc heap is only sampled when plugins are added and removed
+ * (mallinfo walks all arenas): the growth while a plugin is constructed
+ * and what is freed from its removal until it is finalized are accounted
+ * to it. The heap is shared, so allocations of other threads in the
+ * meantime are included and what a plugin allocates in its callbacks is
+ * only seen once it is freed: the numbers show trends, not exact
+ * ownership.
+ *
+ * The plugin and the widgets it contains when added are followed with
+ * weak references. Their number alive is listed per plugin id, also
+ * after the plugin is removed, where it shows leaked references.
+ *
+ * The metrics then also list the number of instances of each GObject
+ * type, if GLib counts them (GLib 2.44 and GOBJECT_DEBUG=instance-count
+ * set in the environment). */
+void
+hd_metrics_memory_init (void)
+{
+  if (!getenv ("HD_STATUS_MENU_MEMORY_ACCOUNTING"))
+    return;
+
+  /* Before the first slice is allocated */
+  g_setenv ("G_SLICE", "always-malloc", FALSE);
+
+#if defined (HAVE_MALLINFO2) || defined (HAVE_MALLINFO)
+  memory_accounting = TRUE;
+#else
+  g_warning ("%s: memory accounting is not supported on this system",
+             __FUNCTION__);
+#endif
+
+#if GLIB_CHECK_VERSION(2,44,0)
+  if (!getenv ("GOBJECT_DEBUG") ||
+      !strstr (getenv ("GOBJECT_DEBUG"), "instance-count"))
+    g_warning ("%s: set GOBJECT_DEBUG=instance-count for instance counts",
+               __FUNCTION__);
+#endif
+}
+
+static HDMetricsPlugin *
+lookup_plugin (const gchar *plugin_id)
+{
+  HDMetricsPlugin *record;
+
+  if (G_UNLIKELY (!quark_hd_metrics_plugin))
+    {
+      quark_hd_metrics_plugin = g_quark_from_static_string (hd_metrics_plugin);
+      plugins = g_hash_table_new_full (g_str_hash, g_str_equal,
+                                       g_free, g_free);
+    }
+
+  record = g_hash_table_lookup (plugins, plugin_id);
+  if (!record)
+    {
+      record = g_new0 (HDMetricsPlugin, 1);
+      g_hash_table_insert (plugins, g_strdup (plugin_id), record);
+    }
+
+  return record;
+}
+
+static HDMetricsPlugin *
+get_plugin (GObject *plugin)
+{
+  HDMetricsPlugin *record;
+  gchar *plugin_id;
+
+  /* The record is cached on the plugin, so the plugin id is only
+   * queried once */
+  if (G_LIKELY (quark_hd_metrics_plugin))
+    {
+      record = g_object_get_qdata (plugin, quark_hd_metrics_plugin);
+      if (record)
+        return record;
+    }
+
+  if (!HD_IS_PLUGIN_ITEM (plugin))
+    return NULL;
+
+  plugin_id = hd_plugin_item_get_plugin_id (HD_PLUGIN_ITEM (plugin));
+  if (!plugin_id)
+    return NULL;
+
+  record = lookup_plugin (plugin_id);
+  g_free (plugin_id);
+
+  g_object_set_qdata (plugin, quark_hd_metrics_plugin, record);
+
+  return record;
+}
+
+/* Marks the start of a call into the code of plugin, returns the CPU
+ * time to pass to hd_metrics_plugin_leave */
+guint64
+hd_metrics_plugin_enter (GObject *plugin)
+{
+  return hd_metrics_get_cpu_time ();
+}
+
+void
+hd_metrics_plugin_leave (GObject            *plugin,
+                         HDMetricsPluginCpu  kind,
+                         guint64             cpu_start)
+{
+  HDMetricsPlugin *record;
+  guint64 cpu_time = hd_metrics_get_cpu_time () - cpu_start;
+
+  g_return_if_fail (G_IS_OBJECT (plugin));
+  g_return_if_fail (kind < HD_METRICS_N_PLUGIN_CPU);
+
+  record = get_plugin (plugin);
+  if (record)
+    record->cpu[kind] += cpu_time;
+}
+
+static void
+instance_finalized (gpointer  data,
+                    GObject  *instance)
+{
+  HDMetricsPlugin *record = data;
+
+  record->n_instances--;
+}
+
+static void
+track_instances (GtkWidget       *widget,
+                 HDMetricsPlugin *record)
+{
+  record->n_instances++;
+  g_object_weak_ref (G_OBJECT (widget), instance_finalized, record);
+
+  if (GTK_IS_CONTAINER (widget))
+    gtk_container_forall (GTK_CONTAINER (widget),
+                          (GtkCallback) track_instances, record);
+}
+
+/* While the plugin manager loads the plugins, everything done since the
+ * load started or the last plugin-added emission (see
+ * hd_metrics_plugin_load_resume) is the construction of the next plugin
+ * added (see hd_metrics_plugin_loaded). */
+void
+hd_metrics_plugin_load_begin (void)
+{
+  loading = TRUE;
+  hd_metrics_plugin_load_resume ();
+}
+
+void
+hd_metrics_plugin_loaded (GObject *plugin)
+{
+  HDMetricsPlugin *record;
+  gsize heap_in_use = 0;
+
+  /* Before the lookup of the record, which can allocate */
+  if (loading && memory_accounting)
+    heap_in_use = hd_metrics_get_heap_in_use ();
+
+  record = get_plugin (plugin);
+  if (!record)
+    return;
+
+  /* Also for plugins added after the load */
+  if (memory_accounting && GTK_IS_WIDGET (plugin))
+    track_instances (GTK_WIDGET (plugin), record);
+
+  if (!loading)
+    return;
+
+  record->cpu[HD_METRICS_PLUGIN_CONSTRUCT] += hd_metrics_get_cpu_time () - load_cpu_mark;
+
+  if (memory_accounting)
+    account_heap (record, load_memory_mark, heap_in_use);
+}
+
+static void
+plugin_finalized (gpointer  data,
+                  GObject  *plugin)
+{
+  HDMetricsRemoval *removal = data;
+
+  account_heap (removal->record, removal->heap_mark,
+                hd_metrics_get_heap_in_use ());
+
+  g_slice_free (HDMetricsRemoval, removal);
+}
+
+/* Called when plugin is removed, what is freed until it is finalized is
+ * accounted to it */
+void
+hd_metrics_plugin_removed (GObject *plugin)
+{
+  HDMetricsRemoval *removal;
+  HDMetricsPlugin *record;
+
+  if (!memory_accounting)
+    return;
+
+  record = get_plugin (plugin);
+  if (!record)
+    return;
+
+  removal = g_slice_new (HDMetricsRemoval);
+  removal->record = record;
+  g_object_weak_ref (plugin, plugin_finalized, removal);
+
+  /* After the allocations above */
+  removal->heap_mark = hd_metrics_get_heap_in_use ();
+}
+
+void
+hd_metrics_plugin_load_resume (void)
+{
+  if (!loading)
+    return;
+
+  if (memory_accounting)
+    load_memory_mark = hd_metrics_get_heap_in_use ();
+
+  load_cpu_mark = hd_metrics_get_cpu_time ();
+}
+
+void
+hd_metrics_plugin_load_end (void)
+{
+  loading = FALSE;
+}
+
+/* Size of the pixel data of the current Status Area icon of plugin */
+void
+hd_metrics_plugin_set_icon_bytes (GObject *plugin,
+                                  gsize    n_bytes)
+{
+  HDMetricsPlugin *record;
+
+  g_return_if_fail (G_IS_OBJECT (plugin));
+
+  record = get_plugin (plugin);
+  if (record)
+    record->icon_bytes = n_bytes;
+}
+
+/* Called on the main thread once the preloading is finished */
+void
+hd_metrics_plugin_set_preload_saved (const gchar *plugin_id,
+                                     guint64      usec)
+{
+  g_return_if_fail (plugin_id != NULL);
+
+  lookup_plugin (plugin_id)->preload_saved = usec;
+}
+
+/* Resident set size, 0 if unknown */
+guint64
+hd_metrics_get_rss (void)
+{
+  gchar *contents;
+  unsigned long size, resident;
+  guint64 rss = 0;
+
+  if (!g_file_get_contents ("/proc/self/statm", &contents, NULL, NULL))
+    return 0;
+
+  if (sscanf (contents, "%lu %lu", &size, &resident) == 2)
+    rss = (guint64) resident * sysconf (_SC_PAGESIZE);
+
+  g_free (contents);
+
+  return rss;
+}
+
+static int
+cmp_samples (const void *a,
+             const void *b)
+{
+  guint64 x = *(const guint64 *) a;
+  guint64 y = *(const guint64 *) b;
+
+  return x < y ? -1 : (x > y ? 1 : 0);
+}
+
+typedef void (*HDMetricsFunc) (const gchar *name,
+                               guint64      value,
+                               gpointer     data);
+
+typedef struct _HDMetricsCollector HDMetricsCollector;
+struct _HDMetricsCollector
+{
+  HDMetricsFunc func;
+  gpointer      data;
+};
+
+static void collect (HDMetricsCollector *collector,
+                     guint64             value,
+                     const gchar        *format,
+                     ...) G_GNUC_PRINTF (3, 4);
+
+static void
+collect (HDMetricsCollector *collector,
+         guint64             value,
+         const gchar        *format,
+         ...)
+{
+  va_list args;
+  gchar *name;
+
+  va_start (args, format);
+  name = g_strdup_vprintf (format, args);
+  va_end (args);
+
+  collector->func (name, value, collector->data);
+
+  g_free (name);
+}
+
+static void
+collect_latency (HDMetricsCollector *collector,
+                 HDMetricsLatency    latency)
+{
+  HDMetricsLatencySeries *series = &latencies[latency];
+  const gchar *name = latency_names[latency];
+  guint64 sorted[LATENCY_SAMPLES];
+  guint n;
+
+  collect (collector, series->n_samples, "%s.count", name);
+
+  n = MIN (series->n_samples, LATENCY_SAMPLES);
+  if (n == 0)
+    return;
+
+  memcpy (sorted, series->samples, n * sizeof (guint64));
+  qsort (sorted, n, sizeof (guint64), cmp_samples);
+
+  collect (collector, sorted[n * 50 / 100], "%s.p50", name);
+  collect (collector, sorted[n * 95 / 100], "%s.p95", name);
+  collect (collector, sorted[n * 99 / 100], "%s.p99", name);
+  collect (collector, sorted[n - 1], "%s.max", name);
+}
+
+static void
+collect_plugin (const gchar        *plugin_id,
+                HDMetricsPlugin    *record,
+                HDMetricsCollector *collector)
+{
+  guint i;
+
+  for (i = 0; i < HD_METRICS_N_PLUGIN_CPU; i++)
+    collect (collector, record->cpu[i],
+             "plugin.%s.%s", plugin_id, plugin_cpu_names[i]);
+
+  collect (collector, record->icon_bytes, "plugin.%s.icon-bytes", plugin_id);
+  collect (collector, record->preload_saved, "plugin.%s.preload-saved", plugin_id);
+
+  if (memory_accounting)
+    {
+      collect (collector, record->heap_allocated, "plugin.%s.heap-allocated", plugin_id);
+      collect (collector, record->heap_freed, "plugin.%s.heap-freed", plugin_id);
+      collect (collector, record->n_instances, "plugin.%s.instances", plugin_id);
+    }
+}
+
+#if GLIB_CHECK_VERSION(2,44,0)
+/* Instances of type and its subtypes, by type name */
+static void
+collect_instances (HDMetricsCollector *collector,
+                   GType               type)
+{
+  GType *children;
+  guint n_children, i;
+  int n_instances;
+
+  n_instances = g_type_get_instance_count (type);
+  if (n_instances > 0)
+    collect (collector, n_instances, "instances.%s", g_type_name (type));
+
+  children = g_type_children (type, &n_children);
+  for (i = 0; i < n_children; i++)
+    collect_instances (collector, children[i]);
+  g_free (children);
+}
+#endif
+
+/* Calls func for all metrics, shared by the dump and the snapshot */
+static void
+collect_all (HDMetricsFunc func,
+             gpointer      data)
+{
+  HDMetricsCollector collector = { func, data };
+  guint i;
+
+  collect (&collector, hd_metrics_get_time (), "time");
+
+  for (i = 0; i < HD_METRICS_N_COUNTERS; i++)
+    collect (&collector, counters[i], "%s", counter_names[i]);
+
+  /* Serial of the next request, so the number of X requests issued */
+  collect (&collector,
+           NextRequest (GDK_DISPLAY_XDISPLAY (gdk_display_get_default ())) - 1,
+           "x-requests");
+
+  collect (&collector, hd_metrics_get_rss (), "rss-bytes");
+
+  for (i = 0; i < HD_METRICS_N_LATENCIES; i++)
+    collect_latency (&collector, i);
+
+  if (plugins)
+    g_hash_table_foreach (plugins, (GHFunc) collect_plugin, &collector);
+
+#if GLIB_CHECK_VERSION(2,44,0)
+  if (memory_accounting)
+    collect_instances (&collector, G_TYPE_OBJECT);
+#endif
+}
+
+static void
+write_value (const gchar *name,
+             guint64      value,
+             FILE        *file)
+{
+  fprintf (file, "%s %" G_GUINT64_FORMAT "\n", name, value);
+}
+
+void
+hd_metrics_dump (void)
+{
+  FILE *file;
+
+  g_mkdir_with_parents (HD_METRICS_DIR, 0755);
+
+  /* Write to a temporary file first, so readers never see a partial dump */
+  file = fopen (HD_METRICS_FILE ".tmp", "w");
+  if (!file)
+    {
+      g_warning ("%s: failed to open %s", __FUNCTION__, HD_METRICS_FILE ".tmp");
+      return;
+    }
+
+  collect_all ((HDMetricsFunc) write_value, file);
+
+  fclose (file);
+
+  g_rename (HD_METRICS_FILE ".tmp", HD_METRICS_FILE);
+}
+
+static void
+append_value (const gchar     *name,
+              guint64          value,
+              DBusMessageIter *array)
+{
+  DBusMessageIter entry;
+  dbus_uint64_t v = value;
+
+  dbus_message_iter_open_container (array, DBUS_TYPE_DICT_ENTRY, NULL, &entry);
+  dbus_message_iter_append_basic (&entry, DBUS_TYPE_STRING, &name);
+  dbus_message_iter_append_basic (&entry, DBUS_TYPE_UINT64, &v);
+  dbus_message_iter_close_container (array, &entry);
+}
+
+static DBusHandlerResult
+metrics_message_cb (DBusConnection *connection,
+                    DBusMessage    *message,
+                    void           *data)
+{
+  DBusMessage *reply;
+  DBusMessageIter iter, array;
+
+  if (!dbus_message_is_method_call (message,
+                                    HD_METRICS_DBUS_INTERFACE,
+                                    HD_METRICS_DBUS_GET_SNAPSHOT))
+    return DBUS_HANDLER_RESULT_NOT_YET_HANDLED;
+
+  reply = dbus_message_new_method_return (message);
+  if (!reply)
+    return DBUS_HANDLER_RESULT_NEED_MEMORY;
+
+  dbus_message_iter_init_append (reply, &iter);
+  dbus_message_iter_open_container (&iter, DBUS_TYPE_ARRAY, "{st}", &array);
+  collect_all ((HDMetricsFunc) append_value, &array);
+  dbus_message_iter_close_container (&iter, &array);
+
+  dbus_connection_send (connection, reply, NULL);
+  dbus_message_unref (reply);
+
+  return DBUS_HANDLER_RESULT_HANDLED;
+}
+
+/* Asks for name without waiting for the reply, as in hd-ready.c */
+static void
+request_name (DBusConnection *connection,
+              const gchar    *name)
+{
+  DBusMessage *message;
+  dbus_uint32_t flags = DBUS_NAME_FLAG_DO_NOT_QUEUE;
+
+  message = dbus_message_new_method_call (DBUS_SERVICE_DBUS,
+                                          DBUS_PATH_DBUS,
+                                          DBUS_INTERFACE_DBUS,
+                                          "RequestName");
+  if (!message)
+    return;
+
+  dbus_message_append_args (message,
+                            DBUS_TYPE_STRING, &name,
+                            DBUS_TYPE_UINT32, &flags,
+                            DBUS_TYPE_INVALID);
+  dbus_message_set_no_reply (message, TRUE);
+
+  dbus_connection_send (connection, message, NULL);
+  dbus_message_unref (message);
+}
+
+/* Export GetSnapshot on the session bus, see HD_METRICS_DBUS_NAME */
+static void
+register_dbus_object (void)
+{
+  static const DBusObjectPathVTable vtable = { NULL, metrics_message_cb, };
+  DBusGConnection *connection;
+  DBusConnection *session_bus;
+  GError *error = NULL;
+
+  connection = dbus_g_bus_get (DBUS_BUS_SESSION, &error);
+  if (!connection)
+    {
+      g_warning ("%s: could not connect to the session bus. %s",
+                 __FUNCTION__, error->message);
+      g_error_free (error);
+      return;
+    }
+
+  session_bus = dbus_g_connection_get_connection (connection);
+
+  request_name (session_bus, HD_METRICS_DBUS_NAME);
+
+  if (!dbus_connection_register_object_path (session_bus, HD_METRICS_DBUS_PATH,
+                                             &vtable, NULL))
+    g_warning ("%s: could not register %s", __FUNCTION__, HD_METRICS_DBUS_PATH);
+}
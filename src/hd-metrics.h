@@ -0,0 +1,125 @@
+/*
+ * This file is part of hildon-status-menu
+ * 
+ * Copyright (C) 2010 Nokia Corporation.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * version 2.1 as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ */
+
+#ifndef __HD_METRICS_H__
+#define __HD_METRICS_H__
+
+#include <glib-object.h>
+
+G_BEGIN_DECLS
+
+/* Latencies collected in the running process, in microseconds. The menu
+ * open latencies complement bench-menu-open, which measures them from
+ * outside the process */
+typedef enum
+{
+  HD_METRICS_MENU_OPEN_LANDSCAPE,
+  HD_METRICS_MENU_OPEN_PORTRAIT,
+  HD_METRICS_ROTATION,
+  HD_METRICS_VISIBILITY_PROPAGATION,
+  HD_METRICS_PLUGIN_ADD,
+  HD_METRICS_PLUGIN_REMOVE,
+  HD_METRICS_PLUGIN_READY,
+
+  HD_METRICS_N_LATENCIES
+} HDMetricsLatency;
+
+/* Counters and gauges */
+typedef enum
+{
+  HD_METRICS_MENU_OPENS,
+  HD_METRICS_MENU_ITEMS,
+  HD_METRICS_ICON_UPDATES,
+  HD_METRICS_ICON_UPDATE_CPU,
+  /* Icon changes merged into another one, 0 as each is applied when
+   * notified */
+  HD_METRICS_ICON_UPDATES_COALESCED,
+  HD_METRICS_AREA_RELAYOUTS,
+  HD_METRICS_AREA_EXPOSES,
+  HD_METRICS_VISIBILITY_UPDATES,
+  HD_METRICS_VISIBILITY_CHANGES,
+  HD_METRICS_DBUS_MESSAGES,
+  HD_METRICS_DBUS_FILTER_CPU,
+  HD_METRICS_PLUGINS_ADDED,
+  HD_METRICS_PLUGINS_REMOVED,
+  HD_METRICS_AREA_IMAGES,
+  HD_METRICS_WINDOW_RESIZES,
+  HD_METRICS_PLUGINS_PRELOADED,
+  HD_METRICS_READY_PERMANENT_ITEMS,
+  HD_METRICS_READY_PLUGINS_LOADED,
+  HD_METRICS_PLUGIN_READY_TIMEOUTS,
+
+  HD_METRICS_N_COUNTERS
+} HDMetricsCounter;
+
+/* CPU time spent in callbacks dispatched into plugin code */
+typedef enum
+{
+  HD_METRICS_PLUGIN_CONSTRUCT,
+  HD_METRICS_PLUGIN_VISIBILITY,
+  HD_METRICS_PLUGIN_ICON,
+  HD_METRICS_PLUGIN_LAYOUT,
+
+  HD_METRICS_N_PLUGIN_CPU
+} HDMetricsPluginCpu;
+
+typedef void (*HDMetricsSignalFunc) (void);
+
+void    hd_metrics_init          (void);
+void    hd_metrics_add_signal_handler (int                 signum,
+                                       HDMetricsSignalFunc func);
+
+guint64 hd_metrics_get_time      (void);
+guint64 hd_metrics_get_cpu_time  (void);
+gsize   hd_metrics_get_heap_in_use (void);
+guint64 hd_metrics_get_rss       (void);
+
+void    hd_metrics_add_latency   (HDMetricsLatency  latency,
+                                  guint64           usec);
+
+void    hd_metrics_counter_add   (HDMetricsCounter  counter,
+                                  guint64           value);
+void    hd_metrics_counter_set   (HDMetricsCounter  counter,
+                                  guint64           value);
+guint64 hd_metrics_counter_get   (HDMetricsCounter  counter);
+
+guint64 hd_metrics_plugin_enter  (GObject            *plugin);
+void    hd_metrics_plugin_leave  (GObject            *plugin,
+                                  HDMetricsPluginCpu  kind,
+                                  guint64             cpu_start);
+
+void    hd_metrics_plugin_load_begin  (void);
+void    hd_metrics_plugin_loaded      (GObject *plugin);
+void    hd_metrics_plugin_load_resume (void);
+void    hd_metrics_plugin_load_end    (void);
+void    hd_metrics_plugin_removed     (GObject *plugin);
+
+void    hd_metrics_memory_init   (void);
+void    hd_metrics_plugin_set_icon_bytes (GObject *plugin,
+                                          gsize    n_bytes);
+void    hd_metrics_plugin_set_preload_saved (const gchar *plugin_id,
+                                             guint64      usec);
+
+void    hd_metrics_dump          (void);
+
+G_END_DECLS
+
+#endif
@@ -0,0 +1,457 @@
+/*
+ * This file is part of hildon-status-menu
+ * 
+ * Copyright (C) 2010 Nokia Corporation.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * version 2.1 as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <glib.h>
+#include <glib/gstdio.h>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/inotify.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+#include "hd-plugin-index.h"
+#include "hd-status-menu-config.h"
+#include "hd-wakeups.h"
+
+/* Index of the desktop files in the plugin directory with the fields
+ * needed before the plugin manager runs, so they are not parsed on each
+ * start. One group per desktop file (the plugin id) with its
+ * modification time and the path of its library. The Index group holds
+ * the modification time of the directory, the directory is only read
+ * again if it changed. Files edited in place do not change the directory,
+ * so the indexed files are still checked with a stat each on load.
+ *
+ * The index is loaded on the preload scan thread (see hd-preload.c),
+ * off the startup path of the main thread. Once the plugins are loaded,
+ * an inotify watch on the directory updates the index when plugins are
+ * installed or removed. */
+#define HD_PLUGIN_INDEX_FILE "status-menu-plugin-index"
+
+#define HD_PLUGIN_INDEX_GROUP               "Index"
+#define HD_PLUGIN_INDEX_KEY_DIRECTORY_MTIME "Directory-Mtime"
+#define HD_PLUGIN_INDEX_KEY_MTIME           "Mtime"
+#define HD_PLUGIN_INDEX_KEY_LIBRARY         "Library"
+
+/* Changes are saved after this many seconds, installing a package
+ * changes several files */
+#define SAVE_DELAY 2
+
+static GKeyFile *plugin_index = NULL;
+static gchar    *filename = NULL;
+static guint     save_id = 0;
+
+/* Changed by hd_plugin_index_init, saved once watched */
+static gboolean  dirty = FALSE;
+
+static int       inotify_fd = -1;
+
+/**
+ * hd_plugin_index_read_library:
+ * @desktop_file: path of the desktop file of a plugin
+ *
+ * Returns: the path of the plugin library from the X-Path key of the
+ * desktop file, relative to the plugin library directory, or %NULL
+ **/
+gchar *
+hd_plugin_index_read_library (const gchar *desktop_file)
+{
+  GKeyFile *key_file;
+  gchar *library, *path = NULL;
+
+  key_file = g_key_file_new ();
+
+  if (g_key_file_load_from_file (key_file, desktop_file, G_KEY_FILE_NONE, NULL))
+    {
+      library = g_key_file_get_string (key_file,
+                                       HD_STATUS_MENU_CONFIG_DESKTOP_GROUP,
+                                       HD_STATUS_MENU_CONFIG_KEY_LIBRARY,
+                                       NULL);
+
+      if (library && g_path_is_absolute (library))
+        path = library;
+      else if (library)
+        {
+          path = g_build_filename (HD_PLUGIN_LIB_DIR, library, NULL);
+          g_free (library);
+        }
+    }
+
+  g_key_file_free (key_file);
+
+  return path;
+}
+
+static glong
+get_mtime (const gchar *group,
+           const gchar *key)
+{
+  gchar *value;
+  glong mtime;
+
+  value = g_key_file_get_value (plugin_index, group, key, NULL);
+  if (!value)
+    return -1;
+
+  mtime = strtol (value, NULL, 10);
+  g_free (value);
+
+  return mtime;
+}
+
+static void
+set_mtime (const gchar *group,
+           const gchar *key,
+           glong        mtime)
+{
+  gchar *value;
+
+  value = g_strdup_printf ("%ld", mtime);
+  g_key_file_set_value (plugin_index, group, key, value);
+  g_free (value);
+}
+
+static gboolean
+is_desktop_file (const gchar *name)
+{
+  return g_str_has_suffix (name, ".desktop");
+}
+
+/* Updates the entry of the desktop file name, returns TRUE if the index
+ * changed */
+static gboolean
+update_entry (const gchar *name)
+{
+  gchar *path, *library;
+  struct stat st;
+  gboolean changed = FALSE;
+
+  path = g_build_filename (HD_STATUS_MENU_PLUGIN_DIR, name, NULL);
+
+  if (g_stat (path, &st) != 0)
+    {
+      /* Removed */
+      changed = g_key_file_remove_group (plugin_index, name, NULL);
+    }
+  else if (get_mtime (name, HD_PLUGIN_INDEX_KEY_MTIME) != st.st_mtime)
+    {
+      g_key_file_remove_group (plugin_index, name, NULL);
+      set_mtime (name, HD_PLUGIN_INDEX_KEY_MTIME, st.st_mtime);
+
+      library = hd_plugin_index_read_library (path);
+      if (library)
+        g_key_file_set_string (plugin_index, name, HD_PLUGIN_INDEX_KEY_LIBRARY, library);
+      g_free (library);
+
+      changed = TRUE;
+    }
+
+  g_free (path);
+
+  return changed;
+}
+
+/* Reads the directory, only the changed desktop files are parsed */
+static void
+rescan (void)
+{
+  GDir *dir;
+  const gchar *name;
+  gchar **groups;
+  GHashTable *names;
+  struct stat st;
+  guint i;
+
+  names = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+
+  dir = g_dir_open (HD_STATUS_MENU_PLUGIN_DIR, 0, NULL);
+  if (dir)
+    {
+      while ((name = g_dir_read_name (dir)))
+        if (is_desktop_file (name))
+          {
+            update_entry (name);
+            g_hash_table_insert (names, g_strdup (name), NULL);
+          }
+
+      g_dir_close (dir);
+    }
+
+  /* Remove the entries of desktop files which are gone */
+  groups = g_key_file_get_groups (plugin_index, NULL);
+  for (i = 0; groups[i]; i++)
+    if (strcmp (groups[i], HD_PLUGIN_INDEX_GROUP) &&
+        !g_hash_table_lookup_extended (names, groups[i], NULL, NULL))
+      g_key_file_remove_group (plugin_index, groups[i], NULL);
+  g_strfreev (groups);
+
+  g_hash_table_destroy (names);
+
+  if (g_stat (HD_STATUS_MENU_PLUGIN_DIR, &st) == 0)
+    set_mtime (HD_PLUGIN_INDEX_GROUP, HD_PLUGIN_INDEX_KEY_DIRECTORY_MTIME,
+               st.st_mtime);
+}
+
+static gboolean
+save_cb (gpointer data)
+{
+  gchar *contents, *dir, *tmp_filename;
+  gsize length;
+  GError *error = NULL;
+
+  save_id = 0;
+
+  contents = g_key_file_to_data (plugin_index, &length, NULL);
+
+  dir = g_path_get_dirname (filename);
+  g_mkdir_with_parents (dir, 0755);
+  g_free (dir);
+
+  tmp_filename = g_strconcat (filename, ".tmp", NULL);
+
+  if (!g_file_set_contents (tmp_filename, contents, length, &error))
+    {
+      g_warning ("%s: could not write %s. %s",
+                 __FUNCTION__, tmp_filename, error->message);
+      g_error_free (error);
+    }
+  else if (g_rename (tmp_filename, filename) != 0)
+    g_warning ("%s: could not rename %s. %s",
+               __FUNCTION__, tmp_filename, g_strerror (errno));
+
+  g_free (tmp_filename);
+  g_free (contents);
+
+  return FALSE;
+}
+
+static void
+queue_save (void)
+{
+  if (!save_id)
+    save_id = g_timeout_add_seconds (SAVE_DELAY, save_cb, NULL);
+}
+
+static gboolean
+inotify_cb (GIOChannel   *source,
+            GIOCondition  condition,
+            gpointer      data)
+{
+  gchar buffer[4096] __attribute__ ((aligned (__alignof__ (struct inotify_event))));
+  gboolean changed = FALSE;
+  struct stat st;
+  ssize_t length;
+
+  while ((length = read (inotify_fd, buffer, sizeof (buffer))) > 0)
+    {
+      gchar *p = buffer;
+
+      while (p < buffer + length)
+        {
+          struct inotify_event *event = (struct inotify_event *) p;
+
+          if (event->mask & IN_Q_OVERFLOW)
+            {
+              rescan ();
+              changed = TRUE;
+            }
+          else if (event->len && is_desktop_file (event->name))
+            changed |= update_entry (event->name);
+
+          p += sizeof (struct inotify_event) + event->len;
+        }
+    }
+
+  if (changed)
+    {
+      /* The index is up to date with the directory */
+      if (g_stat (HD_STATUS_MENU_PLUGIN_DIR, &st) == 0)
+        set_mtime (HD_PLUGIN_INDEX_GROUP, HD_PLUGIN_INDEX_KEY_DIRECTORY_MTIME,
+                   st.st_mtime);
+      queue_save ();
+    }
+
+  return TRUE;
+}
+
+static void
+watch_directory (void)
+{
+  GIOChannel *channel;
+
+  inotify_fd = inotify_init ();
+  if (inotify_fd < 0)
+    {
+      g_warning ("%s: could not create inotify instance. %s",
+                 __FUNCTION__, g_strerror (errno));
+      return;
+    }
+
+  fcntl (inotify_fd, F_SETFL, O_NONBLOCK);
+  fcntl (inotify_fd, F_SETFD, FD_CLOEXEC);
+
+  if (inotify_add_watch (inotify_fd, HD_STATUS_MENU_PLUGIN_DIR,
+                         IN_CLOSE_WRITE | IN_MOVED_TO | IN_MOVED_FROM |
+                         IN_DELETE | IN_ATTRIB) < 0)
+    {
+      g_warning ("%s: could not watch %s. %s",
+                 __FUNCTION__, HD_STATUS_MENU_PLUGIN_DIR, g_strerror (errno));
+      close (inotify_fd);
+      inotify_fd = -1;
+      return;
+    }
+
+  channel = g_io_channel_unix_new (inotify_fd);
+  g_io_add_watch (channel, G_IO_IN, inotify_cb, NULL);
+  g_io_channel_unref (channel);
+
+  hd_wakeups_add_fd (inotify_fd, "plugin-index");
+}
+
+static gboolean
+is_directory_changed (void)
+{
+  struct stat st;
+
+  return (g_stat (HD_STATUS_MENU_PLUGIN_DIR, &st) != 0 ||
+          get_mtime (HD_PLUGIN_INDEX_GROUP,
+                     HD_PLUGIN_INDEX_KEY_DIRECTORY_MTIME) != st.st_mtime);
+}
+
+/**
+ * hd_plugin_index_init:
+ *
+ * Loads the index of the plugin directory, reads the directory only if
+ * it changed since the index was saved and parses the desktop files
+ * changed since then. Does not use the main loop, so it can be called on
+ * another thread as long as the main thread does not use the index until
+ * hd_plugin_index_watch() is called.
+ **/
+void
+hd_plugin_index_init (void)
+{
+  if (plugin_index)
+    return;
+
+  filename = g_build_filename (g_get_user_cache_dir (), "hildon-desktop",
+                               HD_PLUGIN_INDEX_FILE, NULL);
+
+  plugin_index = g_key_file_new ();
+  g_key_file_load_from_file (plugin_index, filename, G_KEY_FILE_NONE, NULL);
+
+  if (is_directory_changed ())
+    {
+      rescan ();
+      dirty = TRUE;
+    }
+  else
+    {
+      gchar **groups;
+      guint i;
+
+      /* No file was added or removed, parse the ones changed in place */
+      groups = hd_plugin_index_get_plugins ();
+      for (i = 0; groups[i]; i++)
+        dirty |= update_entry (groups[i]);
+      g_strfreev (groups);
+    }
+}
+
+/**
+ * hd_plugin_index_watch:
+ *
+ * Watches the plugin directory for changes and saves the index if it
+ * changed. Call on the main thread once the index is not used on other
+ * threads anymore. Does nothing if the index was not loaded.
+ **/
+void
+hd_plugin_index_watch (void)
+{
+  if (!plugin_index || inotify_fd >= 0)
+    return;
+
+  watch_directory ();
+
+  /* Catch up with the changes since hd_plugin_index_init, the watch
+   * sees the ones from now on */
+  if (is_directory_changed ())
+    {
+      rescan ();
+      dirty = TRUE;
+    }
+
+  if (dirty)
+    queue_save ();
+  dirty = FALSE;
+}
+
+/**
+ * hd_plugin_index_get_plugins:
+ *
+ * Returns: the ids of the plugins in the plugin directory, free with
+ * g_strfreev()
+ **/
+gchar **
+hd_plugin_index_get_plugins (void)
+{
+  gchar **groups;
+  guint i, j;
+
+  if (!plugin_index)
+    return g_new0 (gchar *, 1);
+
+  groups = g_key_file_get_groups (plugin_index, NULL);
+
+  for (i = 0, j = 0; groups[i]; i++)
+    {
+      if (strcmp (groups[i], HD_PLUGIN_INDEX_GROUP))
+        groups[j++] = groups[i];
+      else
+        g_free (groups[i]);
+    }
+  groups[j] = NULL;
+
+  return groups;
+}
+
+/**
+ * hd_plugin_index_get_library:
+ * @plugin_id: the plugin id, the name of its desktop file
+ *
+ * Returns: the path of the plugin library, %NULL if the plugin is not in
+ * the index or has no library
+ **/
+gchar *
+hd_plugin_index_get_library (const gchar *plugin_id)
+{
+  if (!plugin_index)
+    return NULL;
+
+  return g_key_file_get_string (plugin_index, plugin_id,
+                                HD_PLUGIN_INDEX_KEY_LIBRARY, NULL);
+}
@@ -0,0 +1,39 @@
+/*
+ * This file is part of hildon-status-menu
+ * 
+ * Copyright (C) 2010 Nokia Corporation.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * version 2.1 as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ */
+
+#ifndef __HD_PLUGIN_INDEX_H__
+#define __HD_PLUGIN_INDEX_H__
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+void    hd_plugin_index_init         (void);
+void    hd_plugin_index_watch        (void);
+
+gchar **hd_plugin_index_get_plugins  (void);
+gchar  *hd_plugin_index_get_library  (const gchar *plugin_id);
+
+gchar  *hd_plugin_index_read_library (const gchar *desktop_file);
+
+G_END_DECLS
+
+#endif
@@ -0,0 +1,392 @@
+/*
+ * This file is part of hildon-status-menu
+ * 
+ * Copyright (C) 2010 Nokia Corporation.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * version 2.1 as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <gdk/gdk.h>
+#include <libhildondesktop/libhildondesktop.h>
+
+#include "hd-metrics.h"
+#include "hd-plugin-ready.h"
+#include "hd-status-menu-config.h"
+
+/* Asynchronous plugin initialization. A plugin which has to do slow
+ * work (blocking D-Bus calls, sysfs reads) can start it in its
+ * constructor without blocking and install a boolean "ready" property,
+ * FALSE until the work is done and notified when it becomes TRUE.
+ *
+ * Such a plugin is only packed into the Status Area and Status Menu
+ * when it is ready, or when its deadline expires, so one slow plugin is
+ * shown late without delaying the others. The deadline is the
+ * X-Status-Menu-Ready-Deadline key (milliseconds) of the plugin in
+ * status-menu.plugins, or DEFAULT_DEADLINE, counted from the plugin-added
+ * emission. The key is looked up when the deadline timer is armed, once
+ * the configuration is loaded (see hd_plugin_ready_set_configuration). */
+#define DEFAULT_DEADLINE 3000
+
+#define HD_PLUGIN_READY_PROPERTY "ready"
+
+typedef struct _HDPluginReadyWaiter HDPluginReadyWaiter;
+struct _HDPluginReadyWaiter
+{
+  HDPluginReadyFunc func;
+  gpointer          data;
+};
+
+typedef struct _HDPluginReadyState HDPluginReadyState;
+struct _HDPluginReadyState
+{
+  GObject *plugin;
+  GSList  *waiters;
+
+  gulong   notify_id;
+  guint    deadline_id;
+
+  guint64  start;
+};
+
+static GQuark      quark_hd_plugin_ready_state = 0;
+static const gchar hd_plugin_ready_state[] = "hd_plugin_ready_state";
+
+/* The plugin configuration, owned by the plugin manager */
+static GKeyFile   *configuration = NULL;
+
+/* HDPluginReadyState of the plugins not ready yet */
+static GSList     *pending = NULL;
+
+static HDPluginReadyAllFunc all_ready_func = NULL;
+static gpointer             all_ready_data = NULL;
+static guint                all_ready_id = 0;
+
+/* FALSE if the plugin does not implement the contract */
+static gboolean
+has_ready_property (GObject *plugin)
+{
+  GParamSpec *pspec;
+
+  pspec = g_object_class_find_property (G_OBJECT_GET_CLASS (plugin),
+                                        HD_PLUGIN_READY_PROPERTY);
+
+  return pspec &&
+         pspec->value_type == G_TYPE_BOOLEAN &&
+         (pspec->flags & G_PARAM_READABLE);
+}
+
+static gboolean
+is_ready (GObject *plugin)
+{
+  gboolean ready = TRUE;
+
+  g_object_get (plugin, HD_PLUGIN_READY_PROPERTY, &ready, NULL);
+
+  return ready;
+}
+
+static guint
+get_deadline (GObject *plugin)
+{
+  gchar *plugin_id;
+  gint deadline;
+  GError *error = NULL;
+
+  if (!configuration || !HD_IS_PLUGIN_ITEM (plugin))
+    return DEFAULT_DEADLINE;
+
+  plugin_id = hd_plugin_item_get_plugin_id (HD_PLUGIN_ITEM (plugin));
+  deadline = g_key_file_get_integer (configuration,
+                                     plugin_id,
+                                     HD_STATUS_MENU_CONFIG_KEY_READY_DEADLINE,
+                                     &error);
+  g_free (plugin_id);
+
+  if (error)
+    {
+      g_error_free (error);
+      return DEFAULT_DEADLINE;
+    }
+
+  return MAX (deadline, 0);
+}
+
+static gboolean
+all_ready_cb (gpointer data)
+{
+  all_ready_id = 0;
+
+  if (!pending && all_ready_func)
+    all_ready_func (all_ready_data);
+
+  return FALSE;
+}
+
+static void
+free_state (HDPluginReadyState *state)
+{
+  GSList *w;
+
+  pending = g_slist_remove (pending, state);
+
+  /* Called from an idle, the waiters of the last plugin run after its
+   * state is freed */
+  if (!pending && all_ready_func && !all_ready_id)
+    all_ready_id = gdk_threads_add_idle (all_ready_cb, NULL);
+
+  /* When the plugin is finalized while pending its handlers are already
+   * gone */
+  if (state->notify_id &&
+      g_signal_handler_is_connected (state->plugin, state->notify_id))
+    g_signal_handler_disconnect (state->plugin, state->notify_id);
+  if (state->deadline_id)
+    g_source_remove (state->deadline_id);
+
+  for (w = state->waiters; w; w = w->next)
+    g_slice_free (HDPluginReadyWaiter, w->data);
+  g_slist_free (state->waiters);
+
+  g_slice_free (HDPluginReadyState, state);
+}
+
+/* Calls the waiters, the plugin is ready or its deadline expired */
+static void
+finish (HDPluginReadyState *state,
+        gboolean            late)
+{
+  GObject *plugin = state->plugin;
+  GSList *waiters, *w;
+
+  hd_metrics_add_latency (HD_METRICS_PLUGIN_READY,
+                          hd_metrics_get_time () - state->start);
+  if (late)
+    hd_metrics_counter_add (HD_METRICS_PLUGIN_READY_TIMEOUTS, 1);
+
+  waiters = g_slist_reverse (state->waiters);
+  state->waiters = NULL;
+
+  g_object_ref (plugin);
+  g_object_set_qdata (plugin, quark_hd_plugin_ready_state, NULL);
+
+  for (w = waiters; w; w = w->next)
+    {
+      HDPluginReadyWaiter *waiter = w->data;
+
+      waiter->func (plugin, waiter->data);
+      g_slice_free (HDPluginReadyWaiter, waiter);
+    }
+
+  g_slist_free (waiters);
+  g_object_unref (plugin);
+}
+
+static void
+ready_notify_cb (GObject            *plugin,
+                 GParamSpec         *pspec,
+                 HDPluginReadyState *state)
+{
+  if (is_ready (plugin))
+    finish (state, FALSE);
+}
+
+static gboolean
+deadline_cb (gpointer data)
+{
+  HDPluginReadyState *state = data;
+  gchar *plugin_id = NULL;
+
+  state->deadline_id = 0;
+
+  if (HD_IS_PLUGIN_ITEM (state->plugin))
+    plugin_id = hd_plugin_item_get_plugin_id (HD_PLUGIN_ITEM (state->plugin));
+  g_warning ("%s: plugin %s not ready before its deadline, shown anyway",
+             __FUNCTION__, plugin_id ? plugin_id : "(unknown)");
+  g_free (plugin_id);
+
+  finish (state, TRUE);
+
+  return FALSE;
+}
+
+static void
+arm_deadline (HDPluginReadyState *state)
+{
+  guint64 waited;
+  guint deadline;
+
+  waited = (hd_metrics_get_time () - state->start) / 1000;
+  deadline = get_deadline (state->plugin);
+
+  state->deadline_id = gdk_threads_add_timeout (deadline > waited ? deadline - waited : 0,
+                                                deadline_cb, state);
+}
+
+/**
+ * hd_plugin_ready_set_configuration:
+ * @keyfile: the plugin configuration
+ *
+ * Sets the configuration the deadlines are read from and arms the
+ * deadlines of the plugins deferred before it was loaded. Call on each
+ * ::items-configuration-loaded.
+ **/
+void
+hd_plugin_ready_set_configuration (GKeyFile *keyfile)
+{
+  GSList *s;
+
+  configuration = keyfile;
+
+  if (!configuration)
+    return;
+
+  for (s = pending; s; s = s->next)
+    {
+      HDPluginReadyState *state = s->data;
+
+      if (!state->deadline_id)
+        arm_deadline (state);
+    }
+}
+
+/**
+ * hd_plugin_ready_defer:
+ * @plugin: a plugin just added
+ * @func: called when the plugin is ready
+ * @data: data passed to @func
+ *
+ * If @plugin implements the asynchronous initialization and is not ready
+ * yet, @func is called once it is ready or its deadline expired.
+ *
+ * Returns: %TRUE if @func is deferred, %FALSE if the plugin is ready and
+ * the caller should go on
+ **/
+gboolean
+hd_plugin_ready_defer (GObject           *plugin,
+                       HDPluginReadyFunc  func,
+                       gpointer           data)
+{
+  HDPluginReadyState *state;
+  HDPluginReadyWaiter *waiter;
+
+  g_return_val_if_fail (G_IS_OBJECT (plugin), FALSE);
+  g_return_val_if_fail (func != NULL, FALSE);
+
+  if (G_UNLIKELY (!quark_hd_plugin_ready_state))
+    quark_hd_plugin_ready_state = g_quark_from_static_string (hd_plugin_ready_state);
+
+  /* The same plugin is deferred by the Status Area and Status Menu */
+  state = g_object_get_qdata (plugin, quark_hd_plugin_ready_state);
+  if (!state)
+    {
+      if (!has_ready_property (plugin) || is_ready (plugin))
+        return FALSE;
+
+      state = g_slice_new0 (HDPluginReadyState);
+      state->plugin = plugin;
+      state->start = hd_metrics_get_time ();
+
+      state->notify_id = g_signal_connect (plugin, "notify::" HD_PLUGIN_READY_PROPERTY,
+                                           G_CALLBACK (ready_notify_cb), state);
+      if (configuration)
+        arm_deadline (state);
+
+      pending = g_slist_prepend (pending, state);
+
+      g_object_set_qdata_full (plugin, quark_hd_plugin_ready_state,
+                               state, (GDestroyNotify) free_state);
+    }
+
+  waiter = g_slice_new (HDPluginReadyWaiter);
+  waiter->func = func;
+  waiter->data = data;
+
+  state->waiters = g_slist_prepend (state->waiters, waiter);
+
+  return TRUE;
+}
+
+/**
+ * hd_plugin_ready_cancel:
+ * @plugin: a plugin being removed
+ * @func: the function passed to hd_plugin_ready_defer()
+ * @data: the data passed to hd_plugin_ready_defer()
+ *
+ * Returns: %TRUE if @func was still deferred, it is not called anymore
+ **/
+gboolean
+hd_plugin_ready_cancel (GObject           *plugin,
+                        HDPluginReadyFunc  func,
+                        gpointer           data)
+{
+  HDPluginReadyState *state;
+  GSList *w;
+
+  if (!quark_hd_plugin_ready_state)
+    return FALSE;
+
+  state = g_object_get_qdata (plugin, quark_hd_plugin_ready_state);
+  if (!state)
+    return FALSE;
+
+  for (w = state->waiters; w; w = w->next)
+    {
+      HDPluginReadyWaiter *waiter = w->data;
+
+      if (waiter->func == func && waiter->data == data)
+        {
+          state->waiters = g_slist_delete_link (state->waiters, w);
+          g_slice_free (HDPluginReadyWaiter, waiter);
+
+          if (!state->waiters)
+            g_object_set_qdata (plugin, quark_hd_plugin_ready_state, NULL);
+
+          return TRUE;
+        }
+    }
+
+  return FALSE;
+}
+
+/**
+ * hd_plugin_ready_n_pending:
+ *
+ * Returns: the number of plugins deferred which are not ready yet
+ **/
+guint
+hd_plugin_ready_n_pending (void)
+{
+  return g_slist_length (pending);
+}
+
+/**
+ * hd_plugin_ready_set_all_ready_func:
+ * @func: called when no plugin is pending anymore
+ * @data: data passed to @func
+ *
+ * Sets the function called from an idle each time the last pending
+ * plugin became ready (after its waiters ran) or was removed.
+ **/
+void
+hd_plugin_ready_set_all_ready_func (HDPluginReadyAllFunc func,
+                                    gpointer             data)
+{
+  all_ready_func = func;
+  all_ready_data = data;
+}
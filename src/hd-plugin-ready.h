@@ -0,0 +1,48 @@
+/*
+ * This file is part of hildon-status-menu
+ * 
+ * Copyright (C) 2010 Nokia Corporation.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * version 2.1 as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ */
+
+#ifndef __HD_PLUGIN_READY_H__
+#define __HD_PLUGIN_READY_H__
+
+#include <glib-object.h>
+
+G_BEGIN_DECLS
+
+typedef void (*HDPluginReadyFunc)    (GObject  *plugin,
+                                      gpointer  data);
+typedef void (*HDPluginReadyAllFunc) (gpointer  data);
+
+void     hd_plugin_ready_set_configuration  (GKeyFile             *keyfile);
+
+gboolean hd_plugin_ready_defer              (GObject              *plugin,
+                                             HDPluginReadyFunc     func,
+                                             gpointer              data);
+gboolean hd_plugin_ready_cancel             (GObject              *plugin,
+                                             HDPluginReadyFunc     func,
+                                             gpointer              data);
+
+guint    hd_plugin_ready_n_pending          (void);
+void     hd_plugin_ready_set_all_ready_func (HDPluginReadyAllFunc  func,
+                                             gpointer              data);
+
+G_END_DECLS
+
+#endif
@@ -0,0 +1,598 @@
+/*
+ * This file is part of hildon-status-menu
+ * 
+ * Copyright (C) 2010 Nokia Corporation.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * version 2.1 as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+/* dlinfo */
+#define _GNU_SOURCE
+
+#include <glib.h>
+#include <glib/gstdio.h>
+
+#include <dlfcn.h>
+#include <elf.h>
+#include <fcntl.h>
+#include <link.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+#include "hd-metrics.h"
+#include "hd-plugin-index.h"
+#include "hd-preload.h"
+#include "hd-status-menu-config.h"
+
+/* The plugin libraries and the libraries they depend on are read into the
+ * page cache on worker threads while the main thread initializes Gtk+ and
+ * creates the Status Area. The plugin manager then maps them on the main
+ * thread without waiting for the disk. The plugins to read ahead are
+ * listed from the configuration on a thread of its own, the main thread
+ * only starts it.
+ *
+ * The libraries are not opened on the workers: their constructors (and
+ * the ones of their dependencies, e.g. type registrations) must not run
+ * concurrently with gtk_init on the main thread. */
+
+/* Mainly overlaps the disk reads */
+#define N_THREADS 2
+
+/* Sanity limits for the ELF headers read */
+#define MAX_SECTIONS     4096
+#define MAX_SECTION_SIZE (1024 * 1024)
+
+#if GLIB_SIZEOF_VOID_P == 8
+#define NATIVE_ELF_CLASS ELFCLASS64
+#else
+#define NATIVE_ELF_CLASS ELFCLASS32
+#endif
+
+typedef struct _HDPreloadItem HDPreloadItem;
+struct _HDPreloadItem
+{
+  gchar   *plugin_id;
+  gchar   *desktop_file;
+  gchar   *library;
+  guint    priority;
+
+  /* Set by the worker thread */
+  gboolean done;
+  guint64  start;
+  guint64  time;
+};
+
+static GThreadPool *pool = NULL;
+
+/* Lists the items and pushes them to the pool, see scan_func */
+static GThread              *scan_thread = NULL;
+static HDPreloadPriorityFunc priority_func = NULL;
+static gpointer              priority_data = NULL;
+
+/* Owned by the scan thread until it is joined */
+static GList       *items = NULL;
+
+/* When the plugin manager started to load, see hd_preload_load_begin */
+static guint64      load_start = 0;
+
+/* Libraries already read ahead, shared by the worker threads */
+G_LOCK_DEFINE_STATIC (read_libraries);
+static GHashTable  *read_libraries = NULL;
+
+/* Directories searched for the DT_NEEDED entries besides the one of the
+ * library itself, see get_library_dirs. Set by the scan thread before the
+ * first item is pushed. */
+static gchar      **library_dirs = NULL;
+
+static gboolean
+read_at (int      fd,
+         gpointer buf,
+         gsize    size,
+         off_t    offset)
+{
+  return pread (fd, buf, size, offset) == (ssize_t) size;
+}
+
+/* Returns the DT_NEEDED entries of the shared object @fd */
+static GPtrArray *
+get_needed (int fd)
+{
+  ElfW(Ehdr) ehdr;
+  ElfW(Shdr) *shdrs = NULL;
+  ElfW(Dyn) *dyns = NULL;
+  gchar *strtab = NULL;
+  GPtrArray *needed;
+  gsize strtab_size = 0;
+  guint i, n_dyns = 0;
+
+  needed = g_ptr_array_new ();
+
+  if (!read_at (fd, &ehdr, sizeof (ehdr), 0) ||
+      memcmp (ehdr.e_ident, ELFMAG, SELFMAG) != 0 ||
+      ehdr.e_ident[EI_CLASS] != NATIVE_ELF_CLASS ||
+      ehdr.e_shentsize != sizeof (ElfW(Shdr)) ||
+      ehdr.e_shnum == 0 || ehdr.e_shnum > MAX_SECTIONS)
+    return needed;
+
+  shdrs = g_new (ElfW(Shdr), ehdr.e_shnum);
+  if (!read_at (fd, shdrs, ehdr.e_shnum * sizeof (ElfW(Shdr)), ehdr.e_shoff))
+    goto out;
+
+  for (i = 0; i < ehdr.e_shnum; i++)
+    {
+      ElfW(Shdr) *dynamic = &shdrs[i], *strings;
+
+      if (dynamic->sh_type != SHT_DYNAMIC ||
+          dynamic->sh_link >= ehdr.e_shnum)
+        continue;
+
+      strings = &shdrs[dynamic->sh_link];
+      if (dynamic->sh_size > MAX_SECTION_SIZE ||
+          strings->sh_size > MAX_SECTION_SIZE)
+        break;
+
+      n_dyns = dynamic->sh_size / sizeof (ElfW(Dyn));
+      dyns = g_new (ElfW(Dyn), n_dyns);
+      strtab_size = strings->sh_size;
+      strtab = g_malloc0 (strtab_size + 1);
+
+      if (!read_at (fd, dyns, n_dyns * sizeof (ElfW(Dyn)), dynamic->sh_offset) ||
+          !read_at (fd, strtab, strtab_size, strings->sh_offset))
+        n_dyns = 0;
+
+      break;
+    }
+
+  for (i = 0; i < n_dyns && dyns[i].d_tag != DT_NULL; i++)
+    if (dyns[i].d_tag == DT_NEEDED && dyns[i].d_un.d_val < strtab_size)
+      g_ptr_array_add (needed, g_strdup (strtab + dyns[i].d_un.d_val));
+
+out:
+  g_free (shdrs);
+  g_free (dyns);
+  g_free (strtab);
+
+  return needed;
+}
+
+/* The plugin library directory and the search path of the dynamic loader
+ * for the program (LD_LIBRARY_PATH, its run path and the system
+ * directories). The ld.so cache is not consulted, libraries not found in
+ * these directories are just not read ahead. */
+static gchar **
+get_library_dirs (void)
+{
+  GPtrArray *dirs;
+  Dl_serinfo size, *info;
+  void *handle;
+  guint i;
+
+  dirs = g_ptr_array_new ();
+  g_ptr_array_add (dirs, g_strdup (HD_PLUGIN_LIB_DIR));
+
+  /* The program is already loaded, this runs no constructors */
+  handle = dlopen (NULL, RTLD_LAZY);
+  if (handle && dlinfo (handle, RTLD_DI_SERINFOSIZE, &size) == 0)
+    {
+      info = g_malloc (size.dls_size);
+      info->dls_size = size.dls_size;
+      info->dls_cnt = size.dls_cnt;
+
+      if (dlinfo (handle, RTLD_DI_SERINFO, info) == 0)
+        for (i = 0; i < info->dls_cnt; i++)
+          g_ptr_array_add (dirs, g_strdup (info->dls_serpath[i].dls_name));
+
+      g_free (info);
+    }
+  if (handle)
+    dlclose (handle);
+
+  if (dirs->len == 1)
+    {
+      g_ptr_array_add (dirs, g_strdup ("/lib"));
+      g_ptr_array_add (dirs, g_strdup ("/usr/lib"));
+    }
+
+  g_ptr_array_add (dirs, NULL);
+
+  return (gchar **) g_ptr_array_free (dirs, FALSE);
+}
+
+static gchar *
+find_library (const gchar *name,
+              const gchar *dir)
+{
+  gchar *path;
+  guint i;
+
+  if (g_path_is_absolute (name))
+    return g_strdup (name);
+
+  path = g_build_filename (dir, name, NULL);
+  if (g_file_test (path, G_FILE_TEST_EXISTS))
+    return path;
+  g_free (path);
+
+  for (i = 0; library_dirs[i]; i++)
+    {
+      path = g_build_filename (library_dirs[i], name, NULL);
+      if (g_file_test (path, G_FILE_TEST_EXISTS))
+        return path;
+      g_free (path);
+    }
+
+  return NULL;
+}
+
+/* Reads the whole library in one request instead of page by page when it
+ * is mapped, then does the same for the libraries it depends on */
+static void
+read_ahead (const gchar *path)
+{
+  GPtrArray *needed;
+  struct stat st;
+  gchar *dir;
+  gboolean seen;
+  guint i;
+  int fd;
+
+  G_LOCK (read_libraries);
+  seen = g_hash_table_lookup (read_libraries, path) != NULL;
+  if (!seen)
+    g_hash_table_insert (read_libraries, g_strdup (path), GINT_TO_POINTER (1));
+  G_UNLOCK (read_libraries);
+
+  if (seen)
+    return;
+
+  fd = g_open (path, O_RDONLY, 0);
+  if (fd < 0)
+    return;
+
+  if (fstat (fd, &st) == 0)
+    posix_fadvise (fd, 0, st.st_size, POSIX_FADV_WILLNEED);
+
+  needed = get_needed (fd);
+
+  close (fd);
+
+  dir = g_path_get_dirname (path);
+  for (i = 0; i < needed->len; i++)
+    {
+      gchar *needed_path = find_library (g_ptr_array_index (needed, i), dir);
+
+      if (needed_path)
+        read_ahead (needed_path);
+
+      g_free (needed_path);
+      g_free (g_ptr_array_index (needed, i));
+    }
+  g_free (dir);
+
+  g_ptr_array_free (needed, TRUE);
+}
+
+static void
+preload_func (gpointer data,
+              gpointer user_data)
+{
+  HDPreloadItem *item = data;
+  guint64 start = hd_metrics_get_time ();
+  gchar *path;
+
+  item->start = start;
+
+  /* Desktop files outside of the plugin directory are not indexed */
+  if (item->library)
+    path = g_strdup (item->library);
+  else
+    path = hd_plugin_index_read_library (item->desktop_file);
+  if (!path)
+    return;
+
+  read_ahead (path);
+
+  item->done = TRUE;
+  item->time = hd_metrics_get_time () - start;
+
+  g_free (path);
+}
+
+/**
+ * hd_preload_get_desktop_file:
+ * @key_file: the plugin configuration
+ * @plugin_id: the plugin id
+ *
+ * Returns: the path of the desktop file of the plugin
+ **/
+gchar *
+hd_preload_get_desktop_file (GKeyFile    *key_file,
+                             const gchar *plugin_id)
+{
+  gchar *desktop_file;
+
+  desktop_file = g_key_file_get_string (key_file,
+                                        plugin_id,
+                                        HD_STATUS_MENU_CONFIG_KEY_DESKTOP_FILE,
+                                        NULL);
+  if (!desktop_file)
+    desktop_file = g_build_filename (HD_STATUS_MENU_PLUGIN_DIR,
+                                     plugin_id, NULL);
+
+  return desktop_file;
+}
+
+static gint
+cmp_items (gconstpointer a,
+           gconstpointer b)
+{
+  const HDPreloadItem *x = a, *y = b;
+
+  return x->priority < y->priority ? -1 : (x->priority > y->priority ? 1 : 0);
+}
+
+/* The user configuration takes precedence, as in the plugin manager */
+static GKeyFile *
+load_configuration (const gchar *name)
+{
+  GKeyFile *key_file;
+  gchar *filename;
+  gboolean loaded;
+
+  key_file = g_key_file_new ();
+
+  filename = g_build_filename (g_get_user_config_dir (), "hildon-desktop",
+                               name, NULL);
+  loaded = g_key_file_load_from_file (key_file, filename, G_KEY_FILE_NONE, NULL);
+  g_free (filename);
+
+  if (loaded)
+    return key_file;
+
+  filename = g_build_filename (HD_DESKTOP_CONFIG_PATH, name, NULL);
+  loaded = g_key_file_load_from_file (key_file, filename, G_KEY_FILE_NONE, NULL);
+  g_free (filename);
+
+  if (loaded)
+    return key_file;
+
+  g_key_file_free (key_file);
+
+  return NULL;
+}
+
+/**
+ * hd_preload_load_plugin_configuration:
+ *
+ * Loads status-menu.plugins before the plugin manager does.
+ *
+ * Returns: the configuration or %NULL, free with g_key_file_free()
+ **/
+GKeyFile *
+hd_preload_load_plugin_configuration (void)
+{
+  return load_configuration (HD_STATUS_MENU_CONFIG_PLUGINS_FILE);
+}
+
+/* Whether the plugin manager loads all plugins of the plugin directory,
+ * not only the configured ones */
+static gboolean
+get_load_all_plugins (void)
+{
+  GKeyFile *key_file;
+  gboolean load_all;
+
+  key_file = load_configuration (HD_STATUS_MENU_CONFIG_FILE);
+  if (!key_file)
+    return FALSE;
+
+  load_all = g_key_file_get_boolean (key_file,
+                                     HD_STATUS_MENU_CONFIG_PLUGIN_MANAGER_GROUP,
+                                     HD_STATUS_MENU_CONFIG_KEY_LOAD_ALL_PLUGINS,
+                                     NULL);
+  g_key_file_free (key_file);
+
+  return load_all;
+}
+
+static void
+add_item (const gchar *plugin_id,
+          GKeyFile    *key_file)
+{
+  HDPreloadItem *item;
+
+  item = g_slice_new0 (HDPreloadItem);
+  item->plugin_id = g_strdup (plugin_id);
+  item->desktop_file = hd_preload_get_desktop_file (key_file, plugin_id);
+  item->library = hd_plugin_index_get_library (plugin_id);
+  item->priority = priority_func (plugin_id, key_file, priority_data);
+
+  items = g_list_prepend (items, item);
+}
+
+/* Lists the plugins the plugin manager will load from the configuration,
+ * in the same order, and pushes them to the pool */
+static gpointer
+scan_func (gpointer data)
+{
+  GKeyFile *key_file;
+  gchar **groups;
+  GList *l;
+  guint i;
+
+  library_dirs = get_library_dirs ();
+
+  /* Not used by the main thread before hd_preload_finish */
+  hd_plugin_index_init ();
+
+  key_file = hd_preload_load_plugin_configuration ();
+  if (!key_file)
+    return NULL;
+
+  groups = g_key_file_get_groups (key_file, NULL);
+  for (i = 0; groups[i]; i++)
+    add_item (groups[i], key_file);
+  g_strfreev (groups);
+
+  /* The plugins only found in the plugin directory */
+  if (get_load_all_plugins ())
+    {
+      groups = hd_plugin_index_get_plugins ();
+      for (i = 0; groups[i]; i++)
+        if (!g_key_file_has_group (key_file, groups[i]))
+          add_item (groups[i], key_file);
+      g_strfreev (groups);
+    }
+
+  g_key_file_free (key_file);
+
+  items = g_list_sort (items, cmp_items);
+
+  for (l = items; l; l = l->next)
+    g_thread_pool_push (pool, l->data, NULL);
+
+  return NULL;
+}
+
+/**
+ * hd_preload_start:
+ * @func: the load priority function of the plugin manager
+ * @data: data passed to @func
+ *
+ * Starts reading ahead the libraries of the plugins the plugin manager will
+ * load (and their dependencies) on worker threads, in the same order. The
+ * configuration is read and @func is called on another thread until
+ * hd_preload_load_begin() is called. The libraries are taken from the
+ * plugin index, which is loaded on that thread too (see
+ * hd_plugin_index_init).
+ **/
+void
+hd_preload_start (HDPreloadPriorityFunc func,
+                  gpointer              data)
+{
+  GError *error = NULL;
+
+  if (pool)
+    return;
+
+  priority_func = func;
+  priority_data = data;
+
+  read_libraries = g_hash_table_new_full (g_str_hash, g_str_equal,
+                                          g_free, NULL);
+
+  pool = g_thread_pool_new (preload_func, NULL, N_THREADS, FALSE, &error);
+  if (!pool)
+    {
+      g_warning ("%s: could not create preload threads. %s",
+                 __FUNCTION__, error->message);
+      g_error_free (error);
+      return;
+    }
+
+  scan_thread = g_thread_create (scan_func, NULL, TRUE, &error);
+  if (!scan_thread)
+    {
+      g_warning ("%s: could not create preload thread. %s",
+                 __FUNCTION__, error->message);
+      g_error_free (error);
+    }
+}
+
+/**
+ * hd_preload_load_begin:
+ *
+ * Waits until the plugins to read ahead are listed (usually long done),
+ * so the load priority function is not called anymore. Call before the
+ * plugin manager loads the plugins.
+ **/
+void
+hd_preload_load_begin (void)
+{
+  if (scan_thread)
+    {
+      g_thread_join (scan_thread);
+      scan_thread = NULL;
+    }
+
+  load_start = hd_metrics_get_time ();
+}
+
+static void
+free_item (HDPreloadItem *item)
+{
+  if (item->done)
+    {
+      guint64 saved = 0;
+
+      /* The reading done before the plugin manager started to load is
+       * not waited for on the main thread anymore. What was read after
+       * may still have been ahead of the plugin manager, so this is a
+       * lower bound. */
+      if (load_start > item->start)
+        saved = MIN (load_start - item->start, item->time);
+
+      hd_metrics_plugin_set_preload_saved (item->plugin_id, saved);
+      hd_metrics_counter_add (HD_METRICS_PLUGINS_PRELOADED, 1);
+    }
+
+  g_free (item->plugin_id);
+  g_free (item->desktop_file);
+  g_free (item->library);
+  g_slice_free (HDPreloadItem, item);
+}
+
+/**
+ * hd_preload_finish:
+ *
+ * Drops the libraries not read ahead yet and waits for the ones being
+ * read. Call after the plugin manager loaded the plugins.
+ **/
+void
+hd_preload_finish (void)
+{
+  /* Not done if hd_preload_load_begin was not called */
+  if (scan_thread)
+    {
+      g_thread_join (scan_thread);
+      scan_thread = NULL;
+    }
+
+  if (pool)
+    {
+      g_thread_pool_free (pool, TRUE, TRUE);
+      pool = NULL;
+    }
+
+  g_list_foreach (items, (GFunc) free_item, NULL);
+  g_list_free (items);
+  items = NULL;
+
+  if (read_libraries)
+    {
+      g_hash_table_destroy (read_libraries);
+      read_libraries = NULL;
+    }
+
+  g_strfreev (library_dirs);
+  library_dirs = NULL;
+}
@@ -0,0 +1,45 @@
+/*
+ * This file is part of hildon-status-menu
+ * 
+ * Copyright (C) 2010 Nokia Corporation.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * version 2.1 as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ */
+
+#ifndef __HD_PRELOAD_H__
+#define __HD_PRELOAD_H__
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/* Same signature as the load priority function of the plugin manager */
+typedef guint (*HDPreloadPriorityFunc) (const gchar *plugin_id,
+                                        GKeyFile    *keyfile,
+                                        gpointer     data);
+
+GKeyFile *hd_preload_load_plugin_configuration (void);
+gchar    *hd_preload_get_desktop_file          (GKeyFile    *key_file,
+                                                const gchar *plugin_id);
+
+void hd_preload_start      (HDPreloadPriorityFunc func,
+                            gpointer              data);
+void hd_preload_load_begin (void);
+void hd_preload_finish     (void);
+
+G_END_DECLS
+
+#endif
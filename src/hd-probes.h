@@ -0,0 +1,41 @@
+/*
+ * This file is part of hildon-status-menu
+ * 
+ * Copyright (C) 2010 Nokia Corporation.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * version 2.1 as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ */
+
+#ifndef __HD_PROBES_H__
+#define __HD_PROBES_H__
+
+/* Static probe points (SystemTap SDT, usable from perf, bpftrace and
+ * stap) under the provider hildon_status_menu. A probe is a single nop
+ * when nothing is attached. The *_done probes mark the end of the
+ * operation started by the probe of the same name, for latencies. */
+#ifdef HAVE_SYS_SDT_H
+#include <sys/sdt.h>
+
+#define HD_PROBE(name)             DTRACE_PROBE (hildon_status_menu, name)
+#define HD_PROBE1(name, a)         DTRACE_PROBE1 (hildon_status_menu, name, a)
+#define HD_PROBE2(name, a, b)      DTRACE_PROBE2 (hildon_status_menu, name, a, b)
+#else
+#define HD_PROBE(name)
+#define HD_PROBE1(name, a)
+#define HD_PROBE2(name, a, b)
+#endif
+
+#endif
@@ -0,0 +1,383 @@
+/*
+ * This file is part of hildon-status-menu
+ * 
+ * Copyright (C) 2010 Nokia Corporation.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * version 2.1 as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <glib.h>
+#include <glib/gstdio.h>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+#include "hd-preload.h"
+#include "hd-readahead.h"
+
+/* The files (and byte ranges of them) used up to the first paint of the
+ * Status Area with all plugins loaded are recorded once in this file
+ * and read ahead on a worker thread at the start of the following runs.
+ *
+ * The first line is the signature of the plugin set, the list is
+ * recorded again when status-menu.plugins lists other plugins. Each
+ * following line is "offset length path", a length of 0 is the whole
+ * file.
+ *
+ * The ranges are the resident pages of the mapped plugin libraries and
+ * theme files (gtkrc, icon caches) and the desktop files of the plugins.
+ * The libraries shared with the rest of the desktop (libc, GTK+) are
+ * left out, their pages are resident because of the other processes and
+ * would only make the list longer. Files which are only read (and
+ * closed) are not known, except the desktop files. */
+#define HD_READAHEAD_FILE "status-menu.readahead"
+
+static gchar    *filename = NULL;
+static gchar    *signature = NULL;
+
+/* Recording, the list is recorded at the first paint after the plugins
+ * are loaded */
+static gboolean  recording = FALSE;
+static gboolean  plugins_loaded = FALSE;
+static GKeyFile *plugin_configuration = NULL;
+
+static int
+cmp_strings (const void *a,
+             const void *b)
+{
+  return strcmp (*(gchar * const *) a, *(gchar * const *) b);
+}
+
+/* Signature of the plugin set, the sorted plugin ids */
+static gchar *
+get_signature (GKeyFile *key_file)
+{
+  gchar **groups, *joined, *checksum;
+  gsize n_groups;
+
+  groups = g_key_file_get_groups (key_file, &n_groups);
+  qsort (groups, n_groups, sizeof (gchar *), cmp_strings);
+
+  joined = g_strjoinv ("\n", groups);
+  checksum = g_compute_checksum_for_string (G_CHECKSUM_MD5, joined, -1);
+
+  g_free (joined);
+  g_strfreev (groups);
+
+  return checksum;
+}
+
+static gpointer
+replay_thread (gpointer data)
+{
+  gchar **lines = data;
+  gchar *path = NULL;
+  int fd = -1;
+  guint i;
+
+  /* The first line is the signature */
+  for (i = 1; lines[i]; i++)
+    {
+      guint64 offset, length;
+      int n = 0;
+
+      if (sscanf (lines[i], "%" G_GUINT64_FORMAT " %" G_GUINT64_FORMAT " %n",
+                  &offset, &length, &n) < 2 || !n)
+        continue;
+
+      /* Consecutive ranges of the same file share the descriptor */
+      if (!path || strcmp (path, lines[i] + n))
+        {
+          if (fd >= 0)
+            close (fd);
+
+          path = lines[i] + n;
+          fd = g_open (path, O_RDONLY, 0);
+        }
+
+      if (fd >= 0)
+        posix_fadvise (fd, offset, length, POSIX_FADV_WILLNEED);
+    }
+
+  if (fd >= 0)
+    close (fd);
+
+  g_strfreev (lines);
+
+  return NULL;
+}
+
+/* Returns TRUE if the list matches the current plugin set and is being
+ * replayed */
+static gboolean
+start_replay (void)
+{
+  gchar *contents;
+  gchar **lines;
+  GError *error = NULL;
+
+  if (!g_file_get_contents (filename, &contents, NULL, NULL))
+    return FALSE;
+
+  lines = g_strsplit (contents, "\n", -1);
+  g_free (contents);
+
+  if (!lines[0] || strcmp (lines[0], signature))
+    {
+      g_strfreev (lines);
+      return FALSE;
+    }
+
+#if GLIB_CHECK_VERSION(2,32,0)
+  {
+    GThread *thread = g_thread_try_new ("readahead", replay_thread, lines, &error);
+
+    if (thread)
+      g_thread_unref (thread);
+  }
+#else
+  g_thread_create (replay_thread, lines, FALSE, &error);
+#endif
+
+  if (error)
+    {
+      g_warning ("%s: could not start the readahead thread. %s",
+                 __FUNCTION__, error->message);
+      g_error_free (error);
+      g_strfreev (lines);
+    }
+
+  return TRUE;
+}
+
+/**
+ * hd_readahead_init:
+ *
+ * Reads ahead the files recorded in a previous run on a worker thread,
+ * or prepares recording them if there is no list for the current plugin
+ * set. Call at the very start.
+ **/
+void
+hd_readahead_init (void)
+{
+  if (filename)
+    return;
+
+  plugin_configuration = hd_preload_load_plugin_configuration ();
+  if (!plugin_configuration)
+    return;
+
+  filename = g_build_filename (g_get_user_cache_dir (), "hildon-desktop",
+                               HD_READAHEAD_FILE, NULL);
+  signature = get_signature (plugin_configuration);
+
+  if (start_replay ())
+    {
+      g_key_file_free (plugin_configuration);
+      plugin_configuration = NULL;
+    }
+  else
+    recording = TRUE;
+}
+
+/* Appends the runs of resident pages of the mapping */
+static void
+append_resident_ranges (GString     *list,
+                        const gchar *path,
+                        gpointer     start,
+                        gsize        size,
+                        guint64      offset)
+{
+  gsize page_size = sysconf (_SC_PAGESIZE);
+  gsize n_pages = (size + page_size - 1) / page_size;
+  unsigned char *vec;
+  gsize i, run = 0;
+
+  vec = g_malloc (n_pages);
+
+  if (mincore (start, size, (void *) vec) == 0)
+    {
+      for (i = 0; i <= n_pages; i++)
+        {
+          if (i < n_pages && (vec[i] & 1))
+            continue;
+
+          if (i > run)
+            g_string_append_printf (list, "%" G_GUINT64_FORMAT " %" G_GUINT64_FORMAT " %s\n",
+                                    offset + (guint64) run * page_size,
+                                    (guint64) (i - run) * page_size,
+                                    path);
+          run = i + 1;
+        }
+    }
+
+  g_free (vec);
+}
+
+/* The directories of the mapped files recorded, see above */
+static gchar **
+get_recorded_dirs (void)
+{
+  const gchar * const *data_dirs = g_get_system_data_dirs ();
+  GPtrArray *dirs;
+  guint i;
+
+  dirs = g_ptr_array_new ();
+  g_ptr_array_add (dirs, g_strconcat (HD_PLUGIN_LIB_DIR, "/", NULL));
+  g_ptr_array_add (dirs, g_build_filename (g_get_user_data_dir (),
+                                           "themes/", NULL));
+  g_ptr_array_add (dirs, g_build_filename (g_get_user_data_dir (),
+                                           "icons/", NULL));
+
+  for (i = 0; data_dirs[i]; i++)
+    {
+      g_ptr_array_add (dirs, g_build_filename (data_dirs[i], "themes/", NULL));
+      g_ptr_array_add (dirs, g_build_filename (data_dirs[i], "icons/", NULL));
+    }
+
+  g_ptr_array_add (dirs, NULL);
+
+  return (gchar **) g_ptr_array_free (dirs, FALSE);
+}
+
+static gboolean
+is_recorded (const gchar  *path,
+             gchar       **dirs)
+{
+  guint i;
+
+  for (i = 0; dirs[i]; i++)
+    if (g_str_has_prefix (path, dirs[i]))
+      return TRUE;
+
+  return FALSE;
+}
+
+static void
+append_mapped_files (GString *list)
+{
+  gchar *contents;
+  gchar **lines, **dirs;
+  guint i;
+
+  if (!g_file_get_contents ("/proc/self/maps", &contents, NULL, NULL))
+    return;
+
+  lines = g_strsplit (contents, "\n", -1);
+  g_free (contents);
+
+  dirs = get_recorded_dirs ();
+
+  for (i = 0; lines[i]; i++)
+    {
+      unsigned long start, end, inode;
+      guint64 offset;
+      const gchar *path;
+
+      if (sscanf (lines[i], "%lx-%lx %*s %" G_GINT64_MODIFIER "x %*s %lu",
+                  &start, &end, &offset, &inode) < 4 || inode == 0)
+        continue;
+
+      path = strchr (lines[i], '/');
+      if (!path || !is_recorded (path, dirs) ||
+          g_str_has_suffix (path, " (deleted)"))
+        continue;
+
+      append_resident_ranges (list, path, (gpointer) start, end - start, offset);
+    }
+
+  g_strfreev (dirs);
+  g_strfreev (lines);
+}
+
+static gboolean
+record_idle (gpointer data)
+{
+  GString *list;
+  gchar **groups, *dir, *tmp_filename;
+  GError *error = NULL;
+  guint i;
+
+  list = g_string_new (signature);
+  g_string_append_c (list, '\n');
+
+  groups = g_key_file_get_groups (plugin_configuration, NULL);
+  for (i = 0; groups[i]; i++)
+    {
+      gchar *desktop_file = hd_preload_get_desktop_file (plugin_configuration,
+                                                         groups[i]);
+
+      g_string_append_printf (list, "0 0 %s\n", desktop_file);
+      g_free (desktop_file);
+    }
+  g_strfreev (groups);
+
+  append_mapped_files (list);
+
+  dir = g_path_get_dirname (filename);
+  g_mkdir_with_parents (dir, 0755);
+  g_free (dir);
+
+  tmp_filename = g_strconcat (filename, ".tmp", NULL);
+
+  if (!g_file_set_contents (tmp_filename, list->str, list->len, &error))
+    {
+      g_warning ("%s: could not write %s. %s",
+                 __FUNCTION__, tmp_filename, error->message);
+      g_error_free (error);
+    }
+  else if (g_rename (tmp_filename, filename) != 0)
+    g_warning ("%s: could not rename %s. %s",
+               __FUNCTION__, tmp_filename, g_strerror (errno));
+
+  g_free (tmp_filename);
+  g_string_free (list, TRUE);
+
+  g_key_file_free (plugin_configuration);
+  plugin_configuration = NULL;
+
+  return FALSE;
+}
+
+void
+hd_readahead_plugins_loaded (void)
+{
+  plugins_loaded = TRUE;
+}
+
+/* Called after each paint of the Status Area, the list is recorded once
+ * the paint is done */
+void
+hd_readahead_painted (void)
+{
+  if (!recording || !plugins_loaded)
+    return;
+
+  recording = FALSE;
+
+  g_idle_add (record_idle, NULL);
+}
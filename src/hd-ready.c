@@ -0,0 +1,279 @@
+/*
+ * This file is part of hildon-status-menu
+ * 
+ * Copyright (C) 2010 Nokia Corporation.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * version 2.1 as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <glib.h>
+#include <dbus/dbus.h>
+#include <dbus/dbus-glib.h>
+#include <dbus/dbus-glib-lowlevel.h>
+
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/types.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "hd-metrics.h"
+#include "hd-ready.h"
+
+/* Tells the session when the Status Area is usable, so the rest of the
+ * startup can be scheduled around it. Each stage is notified once:
+ *
+ *   permanent-items  the first paint with the permanent items (clock,
+ *                    signal and battery)
+ *   plugins-loaded   all plugins are loaded
+ *
+ * as the Ready signal on the session bus:
+ *
+ *   dbus-monitor --session "type='signal',interface='com.nokia.HildonStatusMenu',member='Ready'"
+ *
+ * and to the socket in NOTIFY_SOCKET in the sd_notify protocol, READY=1
+ * with the first stage reached. A stage which is never reached (e.g. a
+ * permanent item failed to load) is not notified. The GetReadyStages
+ * method returns the stages reached so far (as), for subscribers which
+ * come late.
+ *
+ * The stamp file stays for crash detection. */
+#define HD_READY_DBUS_NAME       "com.nokia.HildonStatusMenu"
+#define HD_READY_DBUS_PATH       "/com/nokia/HildonStatusMenu"
+#define HD_READY_DBUS_INTERFACE  "com.nokia.HildonStatusMenu"
+#define HD_READY_DBUS_READY      "Ready"
+#define HD_READY_DBUS_GET_STAGES "GetReadyStages"
+
+static const gchar *stage_names[HD_READY_N_STAGES] =
+{
+  "permanent-items",
+  "plugins-loaded"
+};
+
+static const gchar *stage_status[HD_READY_N_STAGES] =
+{
+  "STATUS=Permanent items shown\n",
+  "STATUS=All plugins loaded\n"
+};
+
+static const HDMetricsCounter stage_counters[HD_READY_N_STAGES] =
+{
+  HD_METRICS_READY_PERMANENT_ITEMS,
+  HD_METRICS_READY_PLUGINS_LOADED
+};
+
+static guint64         start_time = 0;
+static gboolean        reached[HD_READY_N_STAGES];
+static gboolean        service_ready = FALSE;
+static DBusConnection *session_bus = NULL;
+
+/**
+ * hd_ready_init:
+ *
+ * Startup times of the stages are measured from here, call at the very
+ * start.
+ **/
+void
+hd_ready_init (void)
+{
+  start_time = hd_metrics_get_time ();
+}
+
+static DBusHandlerResult
+ready_message_cb (DBusConnection *connection,
+                  DBusMessage    *message,
+                  void           *data)
+{
+  DBusMessage *reply;
+  DBusMessageIter iter, array;
+  guint i;
+
+  if (!dbus_message_is_method_call (message,
+                                    HD_READY_DBUS_INTERFACE,
+                                    HD_READY_DBUS_GET_STAGES))
+    return DBUS_HANDLER_RESULT_NOT_YET_HANDLED;
+
+  reply = dbus_message_new_method_return (message);
+  if (!reply)
+    return DBUS_HANDLER_RESULT_NEED_MEMORY;
+
+  dbus_message_iter_init_append (reply, &iter);
+  dbus_message_iter_open_container (&iter, DBUS_TYPE_ARRAY, "s", &array);
+  for (i = 0; i < HD_READY_N_STAGES; i++)
+    if (reached[i])
+      dbus_message_iter_append_basic (&array, DBUS_TYPE_STRING, &stage_names[i]);
+  dbus_message_iter_close_container (&iter, &array);
+
+  dbus_connection_send (connection, reply, NULL);
+  dbus_message_unref (reply);
+
+  return DBUS_HANDLER_RESULT_HANDLED;
+}
+
+/* RequestName without waiting for the reply, the name is only used by
+ * clients calling GetReadyStages */
+static void
+request_name (DBusConnection *connection,
+              const gchar    *name)
+{
+  DBusMessage *message;
+  dbus_uint32_t flags = DBUS_NAME_FLAG_DO_NOT_QUEUE;
+
+  message = dbus_message_new_method_call (DBUS_SERVICE_DBUS,
+                                          DBUS_PATH_DBUS,
+                                          DBUS_INTERFACE_DBUS,
+                                          "RequestName");
+  if (!message)
+    return;
+
+  dbus_message_append_args (message,
+                            DBUS_TYPE_STRING, &name,
+                            DBUS_TYPE_UINT32, &flags,
+                            DBUS_TYPE_INVALID);
+  dbus_message_set_no_reply (message, TRUE);
+
+  dbus_connection_send (connection, message, NULL);
+  dbus_message_unref (message);
+}
+
+/**
+ * hd_ready_export:
+ *
+ * Exports the Ready signal and the GetReadyStages method on the session
+ * bus. Call before the first stage can be reached, nothing on the bus
+ * is waited for.
+ **/
+void
+hd_ready_export (void)
+{
+  static const DBusObjectPathVTable vtable = { NULL, ready_message_cb, };
+  DBusGConnection *connection;
+  GError *error = NULL;
+
+  if (session_bus)
+    return;
+
+  connection = dbus_g_bus_get (DBUS_BUS_SESSION, &error);
+  if (!connection)
+    {
+      g_warning ("%s: could not connect to the session bus. %s",
+                 __FUNCTION__, error->message);
+      g_error_free (error);
+      return;
+    }
+
+  session_bus = dbus_g_connection_get_connection (connection);
+
+  request_name (session_bus, HD_READY_DBUS_NAME);
+
+  if (!dbus_connection_register_object_path (session_bus, HD_READY_DBUS_PATH,
+                                             &vtable, NULL))
+    g_warning ("%s: could not register %s", __FUNCTION__, HD_READY_DBUS_PATH);
+}
+
+static void
+emit_ready_signal (HDReadyStage stage)
+{
+  DBusMessage *message;
+
+  if (!session_bus)
+    return;
+
+  message = dbus_message_new_signal (HD_READY_DBUS_PATH,
+                                     HD_READY_DBUS_INTERFACE,
+                                     HD_READY_DBUS_READY);
+  if (!message)
+    return;
+
+  dbus_message_append_args (message,
+                            DBUS_TYPE_STRING, &stage_names[stage],
+                            DBUS_TYPE_INVALID);
+
+  /* Written out by the main loop, not flushed from the expose */
+  dbus_connection_send (session_bus, message, NULL);
+  dbus_message_unref (message);
+}
+
+/* sd_notify protocol, a datagram to the socket in NOTIFY_SOCKET, an
+ * abstract socket if it starts with @ */
+static void
+notify_socket (const gchar *state)
+{
+  const gchar *path;
+  struct sockaddr_un addr;
+  socklen_t length;
+  int fd;
+
+  path = getenv ("NOTIFY_SOCKET");
+  if (!path || (path[0] != '/' && path[0] != '@') ||
+      strlen (path) >= sizeof (addr.sun_path))
+    return;
+
+  memset (&addr, 0, sizeof (addr));
+  addr.sun_family = AF_UNIX;
+  strncpy (addr.sun_path, path, sizeof (addr.sun_path) - 1);
+  if (path[0] == '@')
+    addr.sun_path[0] = '\0';
+  length = G_STRUCT_OFFSET (struct sockaddr_un, sun_path) + strlen (path);
+
+  fd = socket (AF_UNIX, SOCK_DGRAM, 0);
+  if (fd < 0)
+    return;
+
+  if (sendto (fd, state, strlen (state), MSG_NOSIGNAL,
+              (struct sockaddr *) &addr, length) < 0)
+    g_warning ("%s: could not notify %s", __FUNCTION__, path);
+
+  close (fd);
+}
+
+/**
+ * hd_ready_notify:
+ * @stage: the stage reached
+ *
+ * Notifies the session of @stage, each stage is only notified once.
+ **/
+void
+hd_ready_notify (HDReadyStage stage)
+{
+  g_return_if_fail (stage < HD_READY_N_STAGES);
+
+  if (reached[stage])
+    return;
+
+  reached[stage] = TRUE;
+
+  hd_metrics_counter_set (stage_counters[stage],
+                          hd_metrics_get_time () - start_time);
+
+  emit_ready_signal (stage);
+
+  if (!service_ready)
+    {
+      gchar *state = g_strconcat ("READY=1\n", stage_status[stage], NULL);
+
+      service_ready = TRUE;
+      notify_socket (state);
+      g_free (state);
+    }
+  else
+    notify_socket (stage_status[stage]);
+}
@@ -0,0 +1,44 @@
+/*
+ * This file is part of hildon-status-menu
+ * 
+ * Copyright (C) 2010 Nokia Corporation.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * version 2.1 as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ */
+
+#ifndef __HD_READY_H__
+#define __HD_READY_H__
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/* Startup stages, in the order they are usually reached */
+typedef enum
+{
+  HD_READY_PERMANENT_ITEMS,
+  HD_READY_PLUGINS_LOADED,
+
+  HD_READY_N_STAGES
+} HDReadyStage;
+
+void hd_ready_init   (void);
+void hd_ready_export (void);
+void hd_ready_notify (HDReadyStage stage);
+
+G_END_DECLS
+
+#endif
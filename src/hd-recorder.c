@@ -0,0 +1,260 @@
+/*
+ * This file is part of hildon-status-menu
+ * 
+ * Copyright (C) 2010 Nokia Corporation.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * version 2.1 as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <glib.h>
+#include <glib/gstdio.h>
+#include <libhildondesktop/libhildondesktop.h>
+
+#include <fcntl.h>
+#include <signal.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "hd-metrics.h"
+#include "hd-recorder.h"
+
+/* The flight recorder keeps the last RING_SIZE events in memory. It is
+ * written to HD_RECORDER_FILE on SIGUSR2 and to HD_RECORDER_CRASH_FILE
+ * when the process crashes.
+ *
+ * Both files contain a HDRecorderHeader followed by n_entries
+ * HDRecorderEntry in chronological order, in host byte order. Plugin
+ * events have the address of the plugin as argument, the plugin ids of
+ * these addresses are written to HD_RECORDER_PLUGINS_FILE on SIGUSR2. */
+#define HD_RECORDER_DIR          "/tmp/hildon-desktop/"
+#define HD_RECORDER_FILE         HD_RECORDER_DIR "status-menu.recorder"
+#define HD_RECORDER_PLUGINS_FILE HD_RECORDER_DIR "status-menu.recorder.plugins"
+#define HD_RECORDER_CRASH_FILE   HD_RECORDER_DIR "status-menu.recorder.crash"
+
+/* Must be a power of two */
+#define RING_SIZE 4096
+
+/* Number of removed plugins whose ids are kept for the events of the
+ * ring which still refer to them */
+#define MAX_REMOVED_IDS 32
+
+#define HD_RECORDER_VERSION 1
+
+typedef struct _HDRecorderHeader HDRecorderHeader;
+struct _HDRecorderHeader
+{
+  gchar   magic[4];
+  guint32 version;
+  guint32 entry_size;
+  guint32 n_entries;
+};
+
+typedef struct _HDRecorderEntry HDRecorderEntry;
+struct _HDRecorderEntry
+{
+  guint64 time;
+  guint64 arg;
+  guint32 event;
+  guint32 serial;
+};
+
+static HDRecorderEntry ring[RING_SIZE];
+static volatile gint   ring_index = 0;
+
+/* Plugin id by plugin address */
+static GHashTable *plugin_ids = NULL;
+
+/* Removed plugins still in plugin_ids, oldest first */
+static GQueue removed_plugins = G_QUEUE_INIT;
+
+/* Opened in advance, nothing but write and rename can be done when
+ * crashing */
+static int crash_fd = -1;
+
+static const int crash_signals[] = { SIGSEGV, SIGBUS, SIGILL, SIGFPE, SIGABRT };
+
+/* Adds an event to the ring. Lock-free, the slot is reserved with an
+ * atomic increment so the recorder can be used from any thread. */
+void
+hd_recorder_record (HDRecorderEvent event,
+                    guint64         arg)
+{
+  HDRecorderEntry *entry;
+  guint serial;
+
+#if GLIB_CHECK_VERSION(2,30,0)
+  serial = (guint) g_atomic_int_add (&ring_index, 1);
+#else
+  serial = (guint) g_atomic_int_exchange_and_add (&ring_index, 1);
+#endif
+
+  entry = &ring[serial & (RING_SIZE - 1)];
+  entry->time = hd_metrics_get_time ();
+  entry->arg = arg;
+  entry->event = event;
+  entry->serial = serial;
+}
+
+/* Records a plugin event and remembers the plugin id of the plugin */
+void
+hd_recorder_record_plugin (HDRecorderEvent  event,
+                           GObject         *plugin)
+{
+  gchar *plugin_id;
+
+  hd_recorder_record (event, GPOINTER_TO_SIZE (plugin));
+
+  if (!plugin_ids)
+    return;
+
+  if (event == HD_RECORDER_PLUGIN_ADDED && HD_IS_PLUGIN_ITEM (plugin))
+    {
+      /* A new plugin at the address of a removed one */
+      g_queue_remove (&removed_plugins, plugin);
+
+      plugin_id = hd_plugin_item_get_plugin_id (HD_PLUGIN_ITEM (plugin));
+      g_hash_table_insert (plugin_ids, plugin, plugin_id);
+    }
+  else if (event == HD_RECORDER_PLUGIN_REMOVED &&
+           g_hash_table_lookup (plugin_ids, plugin) &&
+           !g_queue_find (&removed_plugins, plugin))
+    {
+      g_queue_push_tail (&removed_plugins, plugin);
+
+      if (g_queue_get_length (&removed_plugins) > MAX_REMOVED_IDS)
+        g_hash_table_remove (plugin_ids,
+                             g_queue_pop_head (&removed_plugins));
+    }
+}
+
+/* Async-signal-safe */
+static gboolean
+write_ring (int fd)
+{
+  HDRecorderHeader header;
+  guint serial = (guint) ring_index;
+  guint n_entries, first;
+
+  n_entries = MIN (serial, RING_SIZE);
+  first = serial >= RING_SIZE ? serial & (RING_SIZE - 1) : 0;
+
+  memcpy (header.magic, "HDFR", 4);
+  header.version = HD_RECORDER_VERSION;
+  header.entry_size = sizeof (HDRecorderEntry);
+  header.n_entries = n_entries;
+
+  if (write (fd, &header, sizeof (header)) != sizeof (header))
+    return FALSE;
+
+  /* Oldest entries first */
+  if (write (fd, &ring[first],
+             (n_entries - first) * sizeof (HDRecorderEntry)) < 0)
+    return FALSE;
+  if (first && write (fd, ring, first * sizeof (HDRecorderEntry)) < 0)
+    return FALSE;
+
+  return TRUE;
+}
+
+static void
+write_plugin_id (gpointer  plugin,
+                 gchar    *plugin_id,
+                 FILE     *file)
+{
+  fprintf (file, "%" G_GUINT64_FORMAT " %s\n",
+           (guint64) GPOINTER_TO_SIZE (plugin), plugin_id);
+}
+
+void
+hd_recorder_dump (void)
+{
+  FILE *file;
+  int fd;
+
+  g_mkdir_with_parents (HD_RECORDER_DIR, 0755);
+
+  fd = open (HD_RECORDER_FILE ".tmp", O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (fd < 0)
+    {
+      g_warning ("%s: failed to open %s", __FUNCTION__, HD_RECORDER_FILE ".tmp");
+      return;
+    }
+
+  if (write_ring (fd))
+    g_rename (HD_RECORDER_FILE ".tmp", HD_RECORDER_FILE);
+  else
+    g_warning ("%s: failed to write %s", __FUNCTION__, HD_RECORDER_FILE ".tmp");
+
+  close (fd);
+
+  file = fopen (HD_RECORDER_PLUGINS_FILE, "w");
+  if (file)
+    {
+      g_hash_table_foreach (plugin_ids, (GHFunc) write_plugin_id, file);
+      fclose (file);
+    }
+}
+
+static void
+crash_handler (int signal)
+{
+  /* The handler is reset (SA_RESETHAND), the signal is raised again
+   * after the ring is written to get the default action (core dump) */
+  if (crash_fd >= 0 && write_ring (crash_fd))
+    rename (HD_RECORDER_CRASH_FILE ".tmp", HD_RECORDER_CRASH_FILE);
+
+  raise (signal);
+}
+
+void
+hd_recorder_init (void)
+{
+  struct sigaction action;
+  guint i;
+
+  if (plugin_ids)
+    return;
+
+  plugin_ids = g_hash_table_new_full (g_direct_hash, g_direct_equal,
+                                      NULL, g_free);
+
+  /* Dump on SIGUSR2 from the main loop */
+  hd_metrics_add_signal_handler (SIGUSR2, hd_recorder_dump);
+
+  /* The crash file of a previous run is kept until the next crash */
+  g_mkdir_with_parents (HD_RECORDER_DIR, 0755);
+  crash_fd = open (HD_RECORDER_CRASH_FILE ".tmp",
+                   O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (crash_fd < 0)
+    {
+      g_warning ("%s: failed to open %s",
+                 __FUNCTION__, HD_RECORDER_CRASH_FILE ".tmp");
+      return;
+    }
+
+  memset (&action, 0, sizeof (action));
+  action.sa_handler = crash_handler;
+  action.sa_flags = SA_RESETHAND;
+  sigemptyset (&action.sa_mask);
+
+  for (i = 0; i < G_N_ELEMENTS (crash_signals); i++)
+    sigaction (crash_signals[i], &action, NULL);
+}
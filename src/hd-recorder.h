@@ -0,0 +1,55 @@
+/*
+ * This file is part of hildon-status-menu
+ * 
+ * Copyright (C) 2010 Nokia Corporation.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * version 2.1 as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ */
+
+#ifndef __HD_RECORDER_H__
+#define __HD_RECORDER_H__
+
+#include <glib-object.h>
+
+G_BEGIN_DECLS
+
+/* Events in the flight recorder, the values are part of the dump format
+ * so new events are only appended */
+typedef enum
+{
+  HD_RECORDER_PLUGIN_ADDED,
+  HD_RECORDER_PLUGIN_REMOVED,
+  HD_RECORDER_ICON_CHANGED,
+  HD_RECORDER_VISIBILITY_CHANGED,
+  HD_RECORDER_AREA_RELAYOUT,
+  HD_RECORDER_AREA_RESIZE,
+  HD_RECORDER_MENU_OPEN,
+  HD_RECORDER_MENU_CLOSE,
+  HD_RECORDER_DBUS_SIGNAL
+} HDRecorderEvent;
+
+void hd_recorder_init          (void);
+
+void hd_recorder_record        (HDRecorderEvent  event,
+                                guint64          arg);
+void hd_recorder_record_plugin (HDRecorderEvent  event,
+                                GObject         *plugin);
+
+void hd_recorder_dump          (void);
+
+G_END_DECLS
+
+#endif
@@ -0,0 +1,185 @@
+/*
+ * This file is part of hildon-status-menu
+ * 
+ * Copyright (C) 2010 Nokia Corporation.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * version 2.1 as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <gdk/gdk.h>
+
+#include "hd-screen.h"
+#include "hd-x-audit.h"
+
+#define HD_SCREEN_GET_PRIVATE(object) \
+  (G_TYPE_INSTANCE_GET_PRIVATE ((object), HD_TYPE_SCREEN, HDScreenPrivate))
+
+struct _HDScreenPrivate
+{
+  GdkScreen *gdk_screen;
+
+  gint width;
+  gint height;
+
+  gboolean portrait : 1;
+};
+
+enum
+{
+  ORIENTATION_CHANGED,
+
+  LAST_SIGNAL
+};
+
+static guint screen_signals[LAST_SIGNAL] = { 0, };
+
+static void hd_screen_dispose (GObject *object);
+
+static void size_changed_cb (GdkScreen *gdk_screen,
+                             HDScreen  *screen);
+
+G_DEFINE_TYPE (HDScreen, hd_screen, G_TYPE_OBJECT);
+
+HDScreen *
+hd_screen_get (void)
+{
+  static gpointer screen = NULL;
+
+  if (screen == NULL)
+    {
+      screen = g_object_new (HD_TYPE_SCREEN,
+                             NULL);
+      g_object_add_weak_pointer (screen, &screen);
+      return screen;
+    }
+  else
+    {
+      return g_object_ref (screen);
+    }
+}
+
+static void
+hd_screen_class_init (HDScreenClass *klass)
+{
+  GObjectClass *object_class = G_OBJECT_CLASS (klass);
+
+  object_class->dispose = hd_screen_dispose;
+
+  /* Emitted once when the screen is rotated (the portrait flag changes),
+   * after the cached geometry is updated. Other size changes only update
+   * the geometry. Handlers are called in the order they were
+   * connected and should only queue the relayout. */
+  screen_signals[ORIENTATION_CHANGED] = g_signal_new ("orientation-changed",
+                                                      HD_TYPE_SCREEN,
+                                                      0, 0,
+                                                      NULL, NULL,
+                                                      g_cclosure_marshal_VOID__VOID,
+                                                      G_TYPE_NONE,
+                                                      0);
+
+  g_type_class_add_private (klass, sizeof (HDScreenPrivate));
+}
+
+static void
+update_geometry (HDScreen *screen)
+{
+  HDScreenPrivate *priv = screen->priv;
+
+  priv->width = gdk_screen_get_width (priv->gdk_screen);
+  priv->height = gdk_screen_get_height (priv->gdk_screen);
+  priv->portrait = priv->height > priv->width;
+}
+
+static void
+hd_screen_init (HDScreen *screen)
+{
+  HDScreenPrivate *priv;
+
+  screen->priv = priv = HD_SCREEN_GET_PRIVATE (screen);
+
+  /* GDK listens to XRandR and emits ::size-changed */
+  priv->gdk_screen = g_object_ref (gdk_screen_get_default ());
+  g_signal_connect (priv->gdk_screen, "size-changed",
+                    G_CALLBACK (size_changed_cb), screen);
+
+  update_geometry (screen);
+}
+
+static void
+size_changed_cb (GdkScreen *gdk_screen,
+                 HDScreen  *screen)
+{
+  HDScreenPrivate *priv = screen->priv;
+  gboolean portrait = priv->portrait;
+
+  update_geometry (screen);
+
+  if (portrait == priv->portrait)
+    return;
+
+  hd_x_audit_begin (HD_X_AUDIT_ROTATION);
+
+  g_signal_emit (screen,
+                 screen_signals[ORIENTATION_CHANGED],
+                 0);
+
+  hd_x_audit_end ();
+}
+
+static void
+hd_screen_dispose (GObject *object)
+{
+  HDScreen *screen = HD_SCREEN (object);
+  HDScreenPrivate *priv = screen->priv;
+
+  if (priv->gdk_screen)
+    {
+      g_signal_handlers_disconnect_by_func (priv->gdk_screen,
+                                            size_changed_cb,
+                                            screen);
+      priv->gdk_screen = (g_object_unref (priv->gdk_screen), NULL);
+    }
+
+  G_OBJECT_CLASS (hd_screen_parent_class)->dispose (object);
+}
+
+gboolean
+hd_screen_is_portrait (HDScreen *screen)
+{
+  g_return_val_if_fail (HD_IS_SCREEN (screen), FALSE);
+
+  return screen->priv->portrait;
+}
+
+gint
+hd_screen_get_width (HDScreen *screen)
+{
+  g_return_val_if_fail (HD_IS_SCREEN (screen), 0);
+
+  return screen->priv->width;
+}
+
+gint
+hd_screen_get_height (HDScreen *screen)
+{
+  g_return_val_if_fail (HD_IS_SCREEN (screen), 0);
+
+  return screen->priv->height;
+}
@@ -0,0 +1,62 @@
+/*
+ * This file is part of hildon-status-menu
+ * 
+ * Copyright (C) 2010 Nokia Corporation.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * version 2.1 as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ */
+
+#ifndef __HD_SCREEN_H__
+#define __HD_SCREEN_H__
+
+#include <glib-object.h>
+
+G_BEGIN_DECLS
+
+#define HD_TYPE_SCREEN            (hd_screen_get_type ())
+#define HD_SCREEN(obj)            (G_TYPE_CHECK_INSTANCE_CAST ((obj), HD_TYPE_SCREEN, HDScreen))
+#define HD_SCREEN_CLASS(klass)    (G_TYPE_CHECK_CLASS_CAST ((klass), HD_TYPE_SCREEN, HDScreenClass))
+#define HD_IS_SCREEN(obj)         (G_TYPE_CHECK_INSTANCE_TYPE ((obj), HD_TYPE_SCREEN))
+#define HD_IS_SCREEN_CLASS(klass) (G_TYPE_CHECK_CLASS_TYPE ((klass), HD_TYPE_SCREEN))
+#define HD_SCREEN_GET_CLASS(obj)  (G_TYPE_INSTANCE_GET_CLASS ((obj), HD_TYPE_SCREEN, HDScreenClass))
+
+typedef struct _HDScreen        HDScreen;
+typedef struct _HDScreenClass   HDScreenClass;
+typedef struct _HDScreenPrivate HDScreenPrivate;
+
+struct _HDScreen
+{
+  GObject parent;
+
+  HDScreenPrivate *priv;
+};
+
+struct _HDScreenClass
+{
+  GObjectClass parent;
+};
+
+GType     hd_screen_get_type    (void);
+
+HDScreen *hd_screen_get         (void);
+
+gboolean  hd_screen_is_portrait (HDScreen *screen);
+gint      hd_screen_get_width   (HDScreen *screen);
+gint      hd_screen_get_height  (HDScreen *screen);
+
+G_END_DECLS
+
+#endif
@@ -23,6 +23,10 @@
 #include <config.h>
 #endif
 
+#include "hd-metrics.h"
+#include "hd-probes.h"
+#include "hd-recorder.h"
+#include "hd-screen.h"
 #include "hd-status-area-box.h"
 
 #include <hildon/hildon.h>
@@ -45,6 +49,9 @@ struct _HDStatusAreaBoxPrivate
   GList *children;
 
   guint max_visible_children;
+
+  HDScreen *screen;
+  gboolean portrait;
 };
 
 typedef struct _HDStatusAreaBoxChild HDStatusAreaBoxChild;
@@ -176,6 +183,10 @@ hd_status_area_box_size_allocate (GtkWidget     *widget,
 
   priv = HD_STATUS_AREA_BOX (widget)->priv;
 
+  hd_metrics_counter_add (HD_METRICS_AREA_RELAYOUTS, 1);
+  hd_recorder_record (HD_RECORDER_AREA_RELAYOUT, allocation->width);
+  HD_PROBE2 (area_box_size_allocate, allocation->width, allocation->height);
+
   border_width = gtk_container_get_border_width (GTK_CONTAINER (widget));
 
   /* chain up */
@@ -221,16 +232,8 @@ hd_status_area_box_size_allocate (GtkWidget     *widget,
 
       gtk_widget_set_child_visible (info->widget, FALSE);
     }
-}
-
-static gboolean
-is_portrait_mode (GtkWidget *widget)
-{
-  GdkScreen *screen;
-
-  screen = gtk_widget_get_screen (widget);
 
-  return gdk_screen_get_height (screen) > gdk_screen_get_width (screen);
+  HD_PROBE2 (area_box_size_allocate_done, allocation->width, allocation->height);
 }
 
 static void
@@ -244,11 +247,6 @@ hd_status_area_box_size_request (GtkWidget      *widget,
 
   priv = HD_STATUS_AREA_BOX (widget)->priv;
 
-  if (is_portrait_mode (widget))
-    priv->max_visible_children = MAX_VISIBLE_CHILDREN_PORTRAIT;
-  else
-    priv->max_visible_children = MAX_VISIBLE_CHILDREN_LANDSCAPE;
-
   border_width = gtk_container_get_border_width (GTK_CONTAINER (widget));
 
   /* calculate number of visible children */
@@ -287,15 +285,39 @@ hd_status_area_box_size_request (GtkWidget      *widget,
     }
 }
 
+static void
+update_portrait (HDStatusAreaBox *box)
+{
+  HDStatusAreaBoxPrivate *priv = box->priv;
+
+  priv->portrait = hd_screen_is_portrait (priv->screen);
+
+  if (priv->portrait)
+    priv->max_visible_children = MAX_VISIBLE_CHILDREN_PORTRAIT;
+  else
+    priv->max_visible_children = MAX_VISIBLE_CHILDREN_LANDSCAPE;
+}
+
+static void
+orientation_changed_cb (HDStatusAreaBox *box)
+{
+  gboolean portrait = box->priv->portrait;
+
+  update_portrait (box);
+
+  if (portrait != box->priv->portrait)
+    gtk_widget_queue_resize (GTK_WIDGET (box));
+}
+
 static void
 hd_status_area_box_realize (GtkWidget *widget)
 {
-  GdkScreen *screen;
+  HDStatusAreaBoxPrivate *priv = HD_STATUS_AREA_BOX (widget)->priv;
 
-  screen = gtk_widget_get_screen (widget);
-  g_signal_connect_swapped (screen, "size-changed",
-                            G_CALLBACK (gtk_widget_queue_resize),
+  g_signal_connect_swapped (priv->screen, "orientation-changed",
+                            G_CALLBACK (orientation_changed_cb),
                             widget);
+  orientation_changed_cb (HD_STATUS_AREA_BOX (widget));
 
   GTK_WIDGET_CLASS (hd_status_area_box_parent_class)->realize (widget);
 }
@@ -303,22 +325,35 @@ hd_status_area_box_realize (GtkWidget *widget)
 static void
 hd_status_area_box_unrealize (GtkWidget *widget)
 {
-  GdkScreen *screen;
+  HDStatusAreaBoxPrivate *priv = HD_STATUS_AREA_BOX (widget)->priv;
 
-  screen = gtk_widget_get_screen (widget);
-  g_signal_handlers_disconnect_by_func (screen,
-                                        gtk_widget_queue_resize,
+  g_signal_handlers_disconnect_by_func (priv->screen,
+                                        orientation_changed_cb,
                                         widget);
 
   GTK_WIDGET_CLASS (hd_status_area_box_parent_class)->unrealize (widget);
 }
 
+static void
+hd_status_area_box_dispose (GObject *object)
+{
+  HDStatusAreaBoxPrivate *priv = HD_STATUS_AREA_BOX (object)->priv;
+
+  if (priv->screen)
+    priv->screen = (g_object_unref (priv->screen), NULL);
+
+  G_OBJECT_CLASS (hd_status_area_box_parent_class)->dispose (object);
+}
+
 static void
 hd_status_area_box_class_init (HDStatusAreaBoxClass *klass)
 {
+  GObjectClass *object_class = G_OBJECT_CLASS (klass);
   GtkContainerClass *container_class = GTK_CONTAINER_CLASS (klass);
   GtkWidgetClass *widget_class = GTK_WIDGET_CLASS (klass);
 
+  object_class->dispose = hd_status_area_box_dispose;
+
   container_class->add = hd_status_area_box_add;
   container_class->remove = hd_status_area_box_remove;
   container_class->forall = hd_status_area_box_forall;
@@ -345,7 +380,8 @@ hd_status_area_box_init (HDStatusAreaBox *box)
 
   box->priv->children = NULL;
 
-  box->priv->max_visible_children = MAX_VISIBLE_CHILDREN_LANDSCAPE;
+  box->priv->screen = hd_screen_get ();
+  update_portrait (box);
 }
 
 GtkWidget *
@@ -423,3 +459,57 @@ hd_status_area_box_reorder_child (HDStatusAreaBox *box,
     }
 }
 
+static gint
+cmp_children (gconstpointer a,
+              gconstpointer b)
+{
+  guint x = ((const HDStatusAreaBoxChild *) a)->priority;
+  guint y = ((const HDStatusAreaBoxChild *) b)->priority;
+
+  return x < y ? -1 : (x > y ? 1 : 0);
+}
+
+/**
+ * hd_status_area_box_reorder_children:
+ * @box: a #HDStatusAreaBox
+ * @func: returns the new position of a child
+ * @data: data passed to @func
+ *
+ * Sets the positions of all children at once. The children list is
+ * sorted once and the box is resized once, only if a child moved.
+ **/
+void
+hd_status_area_box_reorder_children (HDStatusAreaBox             *box,
+                                    HDStatusAreaBoxPositionFunc  func,
+                                    gpointer                     data)
+{
+  HDStatusAreaBoxPrivate *priv;
+  gboolean moved = FALSE;
+  GList *c;
+
+  g_return_if_fail (HD_IS_STATUS_AREA_BOX (box));
+  g_return_if_fail (func != NULL);
+
+  priv = box->priv;
+
+  for (c = priv->children; c; c = c->next)
+    {
+      HDStatusAreaBoxChild *info = c->data;
+      guint position = func (info->widget, data);
+
+      if (info->priority != position)
+        {
+          info->priority = position;
+          moved = TRUE;
+        }
+    }
+
+  if (!moved)
+    return;
+
+  /* Stable, children with the same priority keep their order */
+  priv->children = g_list_sort (priv->children, cmp_children);
+
+  if (GTK_WIDGET_VISIBLE (box))
+    gtk_widget_queue_resize (GTK_WIDGET (box));
+}
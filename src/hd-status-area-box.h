@@ -37,6 +37,9 @@ typedef struct _HDStatusAreaBox        HDStatusAreaBox;
 typedef struct _HDStatusAreaBoxClass   HDStatusAreaBoxClass;
 typedef struct _HDStatusAreaBoxPrivate HDStatusAreaBoxPrivate;
 
+typedef guint (*HDStatusAreaBoxPositionFunc) (GtkWidget *child,
+                                              gpointer   data);
+
 struct _HDStatusAreaBox
 {
   GtkContainer            parent;
@@ -59,6 +62,9 @@ void       hd_status_area_box_pack          (HDStatusAreaBox *box,
 void       hd_status_area_box_reorder_child (HDStatusAreaBox *box,
                                              GtkWidget       *child,
                                              guint            position);
+void       hd_status_area_box_reorder_children (HDStatusAreaBox             *box,
+                                                HDStatusAreaBoxPositionFunc  func,
+                                                gpointer                     data);
 G_END_DECLS
 
 #endif /* __HD_STATUS_AREA_BOX_H__ */
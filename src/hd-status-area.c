@@ -33,10 +33,20 @@
 
 #include "hd-desktop.h"
 #include "hd-display.h"
+#include "hd-load-order.h"
+#include "hd-metrics.h"
+#include "hd-plugin-ready.h"
+#include "hd-probes.h"
+#include "hd-readahead.h"
+#include "hd-ready.h"
+#include "hd-recorder.h"
+#include "hd-screen.h"
 
 #include "hd-status-area-box.h"
 #include "hd-status-menu.h"
 #include "hd-status-menu-config.h"
+#include "hd-trace.h"
+#include "hd-x-audit.h"
 
 #include "hd-status-area.h"
 
@@ -68,10 +78,12 @@ enum
 
 struct _HDStatusAreaPrivate
 {
-  HDPluginManager *plugin_manager;
+  GObject *plugin_manager;
+  GKeyFile *config_key_file;
 
   HDDesktop *desktop;
   HDDisplay *display;
+  HDScreen *screen;
   GList *status_plugins;
 
   GtkWidget *status_menu;
@@ -86,10 +98,41 @@ struct _HDStatusAreaPrivate
 
   gboolean resize_after_map : 1;
   gboolean status_area_visible;
+
+  gboolean portrait;
+
+  /* Permanent items added and configured, the session is notified at
+   * the first paint with all of them (see hd-ready.c) */
+  guint n_permanent_items;
+  guint n_configured_permanent_items;
+  gboolean permanent_items_shown;
+
+  /* Time of the last rotation, 0 after the first paint in the new
+   * orientation */
+  guint64 rotation_start;
+
+  /* Display status changes pending in visibility_id, since
+   * visibility_start */
+  guint visibility_id;
+  guint64 visibility_start;
 };
 
 G_DEFINE_TYPE (HDStatusArea, hd_status_area, GTK_TYPE_WINDOW);
 
+static gboolean
+button_press_event_cb (GtkWidget      *widget,
+                       GdkEventButton *event,
+                       HDStatusArea   *status_area)
+{
+  HDStatusAreaPrivate *priv = status_area->priv;
+
+  /* The menu is shown on release, use the time the finger is down
+   * to lay it out */
+  hd_status_menu_prepare (HD_STATUS_MENU (priv->status_menu));
+
+  return TRUE;
+}
+
 static gboolean
 button_release_event_cb (GtkWidget      *widget,
                        GdkEventButton *event,
@@ -99,26 +142,45 @@ button_release_event_cb (GtkWidget      *widget,
 
   gtk_widget_show (priv->status_menu);
   if (!GTK_WIDGET_VISIBLE (priv->status_menu))
-    /* Failed to show the status menu because it got deleted.
-     * Make sure it doesn't retain the grab. */
-    gtk_grab_remove (GTK_WIDGET (priv->status_menu));
+    {
+      /* Failed to show the status menu because it got deleted.
+       * Make sure it doesn't retain the grab. */
+      gtk_grab_remove (GTK_WIDGET (priv->status_menu));
+      hd_status_menu_unprepare (HD_STATUS_MENU (priv->status_menu));
+    }
 
   return TRUE;
 }
 
+static gboolean
+grab_broken_event_cb (GtkWidget          *widget,
+                      GdkEventGrabBroken *event,
+                      HDStatusArea       *status_area)
+{
+  HDStatusAreaPrivate *priv = status_area->priv;
+
+  /* No release will follow the press */
+  hd_status_menu_unprepare (HD_STATUS_MENU (priv->status_menu));
+
+  return FALSE;
+}
+
 static gboolean
 is_widget_on_screen (GtkWidget *widget)
 {
   GdkWindow *window;
   gint x, y, width, height;
+  gulong mark;
 
   window = gtk_widget_get_window (widget);
 
   if (!window)
       return FALSE;
 
+  mark = hd_x_audit_mark ();
   gdk_window_get_root_origin (window, &x, &y);
   gdk_window_get_geometry (window, NULL, NULL, &width, &height, NULL);
+  hd_x_audit_round_trips ("is_widget_on_screen", mark);
 
   /* the compositor moves obscured windows off the screen, so we can use
    * that to determine whether the status area is visible */
@@ -132,20 +194,99 @@ update_status_area_visibility (HDStatusArea *status_area)
   gboolean visible;
   GList *l;
 
-  visible = (is_widget_on_screen (GTK_WIDGET (status_area)) &&
-             !hd_desktop_is_task_switcher_visible (priv->desktop) &&
-             hd_display_is_on (priv->display));
+  hd_x_audit_begin (HD_X_AUDIT_VISIBILITY);
+  hd_metrics_counter_add (HD_METRICS_VISIBILITY_UPDATES, 1);
+
+  /* The display first, it needs no X round-trip */
+  visible = (hd_display_is_on (priv->display) &&
+             is_widget_on_screen (GTK_WIDGET (status_area)) &&
+             !hd_desktop_is_task_switcher_visible (priv->desktop));
 
   if (visible != priv->status_area_visible)
     {
       priv->status_area_visible = visible;
 
+      hd_metrics_counter_add (HD_METRICS_VISIBILITY_CHANGES, 1);
+      hd_recorder_record (HD_RECORDER_VISIBILITY_CHANGED, visible);
+      HD_PROBE1 (visibility_changed, visible);
+
       /* inform status area plugins if the status area is obscured or not */
       for (l = priv->status_plugins; l; l = l->next)
         {
+          guint64 cpu_start = hd_metrics_plugin_enter (l->data);
+
           g_object_set (l->data, "status-area-visible", visible, NULL);
+
+          hd_metrics_plugin_leave (l->data, HD_METRICS_PLUGIN_VISIBILITY,
+                                   cpu_start);
+        }
+
+      HD_PROBE1 (visibility_changed_done, visible);
+    }
+
+  /* Display status signal to the plugins informed */
+  if (priv->visibility_start)
+    {
+      hd_metrics_add_latency (HD_METRICS_VISIBILITY_PROPAGATION,
+                              hd_metrics_get_time () - priv->visibility_start);
+      priv->visibility_start = 0;
+    }
+
+  hd_x_audit_end ();
+}
+
+static gboolean
+visibility_idle_cb (gpointer data)
+{
+  HDStatusArea *status_area = HD_STATUS_AREA (data);
+
+  status_area->priv->visibility_id = 0;
+
+  update_status_area_visibility (status_area);
+
+  return FALSE;
+}
+
+static void
+display_status_changed_cb (HDStatusArea *status_area)
+{
+  HDStatusAreaPrivate *priv = status_area->priv;
+
+  if (!priv->visibility_start)
+    priv->visibility_start = hd_metrics_get_time ();
+
+  /* Switching the display off stops the plugins right away, whatever
+   * else is pending. Then the Status Area is hidden and a further "off"
+   * needs no X round-trip, so a burst costs at most one update per
+   * "on" that got through. */
+  if (!hd_display_is_on (priv->display))
+    {
+      if (priv->visibility_id)
+        {
+          g_source_remove (priv->visibility_id);
+          priv->visibility_id = 0;
         }
+
+      update_status_area_visibility (status_area);
+      return;
     }
+
+  /* "On" is coalesced: the idle only runs once the bus connection is
+   * drained (the D-Bus watch and dispatch sources have the default
+   * priority and libdbus reads a burst in several chunks), so a burst of
+   * display status changes ending "on" results in a single visibility
+   * update (with X round-trips and notifications of all plugins). It
+   * still runs before GTK+ resizes and redraws.
+   *
+   * HDDisplay does not emit for repeated or dimmed states. Each "on" used
+   * to re-check is_widget_on_screen here; whether the Status Area is on
+   * screen is followed by configure_event_cb and the task switcher
+   * handlers instead, so a repeated "on" does not need it. */
+  if (!priv->visibility_id)
+    priv->visibility_id = gdk_threads_add_idle_full (G_PRIORITY_HIGH_IDLE,
+                                                     visibility_idle_cb,
+                                                     status_area,
+                                                     NULL);
 }
 
 static gboolean
@@ -157,11 +298,46 @@ configure_event_cb (GtkWidget         *widget,
 
   status_area = HD_STATUS_AREA (widget);
 
+  hd_recorder_record (HD_RECORDER_AREA_RESIZE,
+                      ((guint64) event->width << 32) | (guint32) event->height);
+
   update_status_area_visibility (status_area);
 
   return FALSE;
 }
 
+static void
+update_alignemnt_padding (HDStatusArea *status_area)
+{
+  HDStatusAreaPrivate *priv = status_area->priv;
+  guint left_right_padding;
+
+  if (priv->portrait)
+    left_right_padding = HILDON_MARGIN_DEFAULT;
+  else
+    left_right_padding = HILDON_MARGIN_DOUBLE;
+
+  gtk_alignment_set_padding (GTK_ALIGNMENT (priv->main_alignment),
+                             CUSTOM_MARGIN_9, CUSTOM_MARGIN_9,
+                             left_right_padding, left_right_padding);
+}
+
+static void
+orientation_changed_cb (HDStatusArea *status_area)
+{
+  HDStatusAreaPrivate *priv = status_area->priv;
+  gboolean portrait = hd_screen_is_portrait (priv->screen);
+
+  /* Only the orientation changes the layout */
+  if (portrait == priv->portrait)
+    return;
+
+  priv->portrait = portrait;
+  priv->rotation_start = hd_metrics_get_time ();
+
+  update_alignemnt_padding (status_area);
+}
+
 static void
 hd_status_area_init (HDStatusArea *status_area)
 {
@@ -179,15 +355,24 @@ hd_status_area_init (HDStatusArea *status_area)
                             G_CALLBACK (update_status_area_visibility), status_area);
   priv->display = hd_display_get ();
   g_signal_connect_swapped (priv->display, "display-status-changed",
-                            G_CALLBACK (update_status_area_visibility), status_area);
+                            G_CALLBACK (display_status_changed_cb), status_area);
   update_status_area_visibility (status_area);
+  priv->screen = hd_screen_get ();
+  g_signal_connect_swapped (priv->screen, "orientation-changed",
+                            G_CALLBACK (orientation_changed_cb), status_area);
+  priv->portrait = hd_screen_is_portrait (priv->screen);
 
   priv->status_plugins = NULL;
 
   /* Create Status area UI */
-  gtk_widget_add_events (GTK_WIDGET (status_area), GDK_BUTTON_RELEASE_MASK);
+  gtk_widget_add_events (GTK_WIDGET (status_area),
+                         GDK_BUTTON_PRESS_MASK | GDK_BUTTON_RELEASE_MASK);
+  g_signal_connect (G_OBJECT (status_area), "button-press-event",
+                    G_CALLBACK (button_press_event_cb), status_area);
   g_signal_connect (G_OBJECT (status_area), "button-release-event",
                     G_CALLBACK (button_release_event_cb), status_area);
+  g_signal_connect (G_OBJECT (status_area), "grab-broken-event",
+                    G_CALLBACK (grab_broken_event_cb), status_area);
   gtk_widget_set_app_paintable (GTK_WIDGET (status_area), TRUE);
   gtk_widget_set_size_request (GTK_WIDGET (status_area), -1, STATUS_AREA_HEIGHT);
 
@@ -281,11 +466,25 @@ hd_status_area_dispose (GObject *object)
   if (priv->display)
     {
       g_signal_handlers_disconnect_by_func (priv->display,
-                                            update_status_area_visibility,
+                                            display_status_changed_cb,
                                             status_area);
       priv->display = (g_object_unref (priv->display), NULL);
     }
 
+  if (priv->visibility_id)
+    {
+      g_source_remove (priv->visibility_id);
+      priv->visibility_id = 0;
+    }
+
+  if (priv->screen)
+    {
+      g_signal_handlers_disconnect_by_func (priv->screen,
+                                            orientation_changed_cb,
+                                            status_area);
+      priv->screen = (g_object_unref (priv->screen), NULL);
+    }
+
   G_OBJECT_CLASS (hd_status_area_parent_class)->dispose (object);
 }
 
@@ -305,6 +504,12 @@ status_area_icon_changed (HDStatusPluginItem *plugin)
 {
   GtkWidget *image;
   GdkPixbuf *pixbuf;
+  guint64 cpu_start = hd_metrics_plugin_enter (G_OBJECT (plugin));
+  guint64 cpu_time;
+
+  hd_recorder_record_plugin (HD_RECORDER_ICON_CHANGED, G_OBJECT (plugin));
+  HD_PROBE1 (icon_changed, plugin);
+  hd_x_audit_begin (HD_X_AUDIT_ICON_UPDATE);
 
   /* Get the image connected with the plugin */
   image = g_object_get_qdata (G_OBJECT (plugin),
@@ -322,21 +527,72 @@ status_area_icon_changed (HDStatusPluginItem *plugin)
            (guint) pixbuf);
            */
 
+  hd_trace_record_icon (G_OBJECT (plugin), pixbuf != NULL);
+
   /* Hide image if icon is not set */
   if (pixbuf)
     {
+      hd_metrics_plugin_set_icon_bytes (G_OBJECT (plugin),
+                                        gdk_pixbuf_get_rowstride (pixbuf) *
+                                        gdk_pixbuf_get_height (pixbuf));
+      hd_load_order_icon_shown (G_OBJECT (plugin));
+
       g_object_unref (pixbuf);
 
       gtk_widget_show (image);
     }
   else
-    gtk_widget_hide (image);
+    {
+      hd_metrics_plugin_set_icon_bytes (G_OBJECT (plugin), 0);
+
+      gtk_widget_hide (image);
+    }
+
+  cpu_time = hd_metrics_get_cpu_time () - cpu_start;
+  hd_metrics_counter_add (HD_METRICS_ICON_UPDATES, 1);
+  hd_metrics_counter_add (HD_METRICS_ICON_UPDATE_CPU, cpu_time);
+  hd_metrics_plugin_leave (G_OBJECT (plugin), HD_METRICS_PLUGIN_ICON, cpu_start);
+
+  hd_x_audit_end ();
+  HD_PROBE1 (icon_changed_done, plugin);
+}
+
+static GKeyFile *
+get_plugin_config_key_file (HDStatusArea *status_area)
+{
+  HDStatusAreaPrivate *priv = status_area->priv;
+
+  if (HD_IS_PLUGIN_MANAGER (priv->plugin_manager))
+    return hd_plugin_manager_get_plugin_config_key_file (HD_PLUGIN_MANAGER (priv->plugin_manager));
+
+  /* Stand-ins only provide the configuration through
+   * ::items-configuration-loaded */
+  return priv->config_key_file;
+}
+
+/* Number of icon images alive, to detect leaks on plugin churn */
+static guint n_images = 0;
+
+static void
+image_finalized_cb (gpointer  data,
+                    GObject  *image)
+{
+  hd_metrics_counter_set (HD_METRICS_AREA_IMAGES, --n_images);
 }
 
+/* The special item images are owned by the Status Area and shared
+ * by all plugins using the special item, so they are only reset
+ * when a plugin is removed */
 static void
-hd_status_area_plugin_added_cb (HDPluginManager *plugin_manager,
-                                GObject         *plugin,
-                                HDStatusArea    *status_area)
+release_special_item_image (GtkWidget *image)
+{
+  gtk_image_clear (GTK_IMAGE (image));
+  gtk_widget_show (image);
+}
+
+static void
+add_status_plugin (GObject      *plugin,
+                   HDStatusArea *status_area)
 {
   HDStatusAreaPrivate *priv = status_area->priv;
   gchar *plugin_id;
@@ -345,14 +601,10 @@ hd_status_area_plugin_added_cb (HDPluginManager *plugin_manager,
   gchar *permanent_item;
   guint i;
 
-  /* Plugin must be a HDStatusMenuItem */
-  if (!HD_IS_STATUS_PLUGIN_ITEM (plugin))
-    return;
-
   g_object_ref (plugin);
 
   /* Read position in Status Menu from plugin configuration */
-  keyfile = hd_plugin_manager_get_plugin_config_key_file (plugin_manager);
+  keyfile = get_plugin_config_key_file (status_area);
   plugin_id = hd_plugin_item_get_plugin_id (HD_PLUGIN_ITEM (plugin));
 
   /* Check if the plugin one of the permament plugins on the left
@@ -376,6 +628,9 @@ hd_status_area_plugin_added_cb (HDPluginManager *plugin_manager,
 
       g_object_unref (clock_widget);
 
+      priv->n_permanent_items++;
+
+      g_free (permanent_item);
       g_free (plugin_id);
       return;
     }
@@ -388,7 +643,9 @@ hd_status_area_plugin_added_cb (HDPluginManager *plugin_manager,
       if (permanent_item && strcmp (value, permanent_item) == 0)
         {
           image = priv->special_item_image [i];
-          g_object_set_qdata_full (plugin, quark_hd_status_area_image, image, (GDestroyNotify) gtk_widget_destroy);
+          g_object_set_qdata_full (plugin, quark_hd_status_area_image, image, (GDestroyNotify) release_special_item_image);
+
+          priv->n_permanent_items++;
 
           g_free (value);
           break;
@@ -404,6 +661,8 @@ hd_status_area_plugin_added_cb (HDPluginManager *plugin_manager,
 
       /* Create GtkImage to display the icon */
       image = gtk_image_new ();
+      g_object_weak_ref (G_OBJECT (image), image_finalized_cb, NULL);
+      hd_metrics_counter_set (HD_METRICS_AREA_IMAGES, ++n_images);
       g_object_set_qdata_full (plugin, quark_hd_status_area_image,
                                image, (GDestroyNotify) gtk_widget_destroy);
       g_object_set_qdata_full (G_OBJECT (image), quark_hd_status_area_plugin_id,
@@ -432,9 +691,28 @@ hd_status_area_plugin_added_cb (HDPluginManager *plugin_manager,
                     G_CALLBACK (status_area_icon_changed), NULL);
   status_area_icon_changed (HD_STATUS_PLUGIN_ITEM (plugin));
 
+  g_free (permanent_item);
   g_free (plugin_id);
 }
 
+static void
+hd_status_area_plugin_added_cb (GObject         *plugin_manager,
+                                GObject         *plugin,
+                                HDStatusArea    *status_area)
+{
+  /* Plugin must be a HDStatusMenuItem */
+  if (!HD_IS_STATUS_PLUGIN_ITEM (plugin))
+    return;
+
+  /* Plugins with asynchronous initialization are added when ready */
+  if (hd_plugin_ready_defer (plugin,
+                             (HDPluginReadyFunc) add_status_plugin,
+                             status_area))
+    return;
+
+  add_status_plugin (plugin, status_area);
+}
+
 static void
 remove_from_container (GtkWidget    *widget,
                        GtkContainer *container)
@@ -444,18 +722,31 @@ remove_from_container (GtkWidget    *widget,
 }
 
 static void
-hd_status_area_plugin_removed_cb (HDPluginManager *plugin_manager,
+hd_status_area_plugin_removed_cb (GObject         *plugin_manager,
                                   GObject         *plugin,
                                   HDStatusArea    *status_area)
 {
   HDStatusAreaPrivate *priv = status_area->priv;
+  GtkWidget *image;
+  guint i;
 
   /* Plugin must be a HDStatusMenuItem */
   if (!HD_IS_STATUS_PLUGIN_ITEM (plugin))
     return;
 
-  if (g_object_get_qdata (plugin, quark_hd_status_area_image))
+  /* Not added yet */
+  if (hd_plugin_ready_cancel (plugin,
+                              (HDPluginReadyFunc) add_status_plugin,
+                              status_area))
+    return;
+
+  image = g_object_get_qdata (plugin, quark_hd_status_area_image);
+  if (image)
     {
+      for (i = 0; i < HD_STATUS_AREA_NUM_SPECIAL_ITEMS; i++)
+        if (image == priv->special_item_image[i])
+          priv->n_permanent_items--;
+
       /* Disconnect signal handler */
       g_signal_handlers_disconnect_by_func (plugin,
                                             status_area_icon_changed,
@@ -469,15 +760,17 @@ hd_status_area_plugin_removed_cb (HDPluginManager *plugin_manager,
       gtk_container_foreach (GTK_CONTAINER (priv->clock_box),
                              (GtkCallback) remove_from_container,
                              priv->clock_box);
+
+      priv->n_permanent_items--;
     }
 
   priv->status_plugins = g_list_remove (priv->status_plugins, plugin);
   g_object_unref (plugin);
 }
 
-static void
-update_position (GtkWidget *child,
-                 GKeyFile  *keyfile)
+static guint
+get_position (GtkWidget *child,
+              GKeyFile  *keyfile)
 {
   gchar *plugin_id;
   guint position;
@@ -498,20 +791,51 @@ update_position (GtkWidget *child,
       position = G_MAXUINT;
     }
 
-  /* Reorder Child */
-  hd_status_area_box_reorder_child (HD_STATUS_AREA_BOX (gtk_widget_get_parent (child)),
-                                    child,
-                                    position);
+  return position;
+}
+
+/* Number of permanent items in the plugin configuration */
+static guint
+count_permanent_items (GKeyFile *keyfile)
+{
+  gchar **groups;
+  guint i, n = 0;
+
+  if (!keyfile)
+    return 0;
+
+  groups = g_key_file_get_groups (keyfile, NULL);
+  for (i = 0; groups[i]; i++)
+    if (g_key_file_has_key (keyfile, groups[i],
+                            HD_STATUS_AREA_CONFIG_KEY_PERMANENT_ITEM, NULL))
+      n++;
+  g_strfreev (groups);
+
+  return n;
 }
 
 static void
-hd_status_area_items_configuration_loaded_cb (HDPluginManager *plugin_manager,
+hd_status_area_items_configuration_loaded_cb (GObject         *plugin_manager,
                                                GKeyFile        *key_file,
                                                HDStatusArea    *status_area)
 {
   HDStatusAreaPrivate *priv = status_area->priv;
 
-  gtk_container_foreach (GTK_CONTAINER (priv->icon_box), (GtkCallback) update_position, key_file);
+  priv->config_key_file = key_file;
+
+  priv->n_configured_permanent_items = count_permanent_items (key_file);
+
+  /* Without permanent items, or if they were all added before, the
+   * stage is reached with the next paint */
+  if (!priv->permanent_items_shown &&
+      priv->n_permanent_items >= priv->n_configured_permanent_items &&
+      GTK_WIDGET_MAPPED (GTK_WIDGET (status_area)))
+    gtk_widget_queue_draw (GTK_WIDGET (status_area));
+
+  /* Only moved children are reordered, in one layout pass */
+  hd_status_area_box_reorder_children (HD_STATUS_AREA_BOX (priv->icon_box),
+                                       (HDStatusAreaBoxPositionFunc) get_position,
+                                       key_file);
 }
 
 static void
@@ -526,6 +850,8 @@ hd_status_area_set_property (GObject      *object,
     {
     case PROP_PLUGIN_MANAGER:
       /* The property is CONSTRUCT_ONLY so there is no value yet */
+      /* Either a HDPluginManager or a stand-in emitting the same
+       * signals (see HDStubPluginManager) */
       priv->plugin_manager = g_value_dup_object (value);
       if (priv->plugin_manager != NULL)
         {
@@ -549,7 +875,11 @@ static gboolean
 hd_status_area_expose_event (GtkWidget *widget,
                              GdkEventExpose *event)
 {
+  HDStatusAreaPrivate *priv = HD_STATUS_AREA (widget)->priv;
   cairo_t *cr;
+  gboolean retval;
+
+  hd_metrics_counter_add (HD_METRICS_AREA_EXPOSES, 1);
 
   /* Create cairo context */
   cr = gdk_cairo_create (GDK_DRAWABLE (widget->window));
@@ -563,35 +893,29 @@ hd_status_area_expose_event (GtkWidget *widget,
 
   cairo_destroy (cr);
 
-  return GTK_WIDGET_CLASS (hd_status_area_parent_class)->expose_event (widget,
-                                                                       event);
-}
-
-static gboolean
-is_portrait_mode (GtkWidget *widget)
-{
-  GdkScreen *screen;
-
-  screen = gtk_widget_get_screen (widget);
+  retval = GTK_WIDGET_CLASS (hd_status_area_parent_class)->expose_event (widget,
+                                                                         event);
 
-  return gdk_screen_get_height (screen) > gdk_screen_get_width (screen);
-}
+  /* First paint after a rotation */
+  if (priv->rotation_start)
+    {
+      hd_metrics_add_latency (HD_METRICS_ROTATION,
+                              hd_metrics_get_time () - priv->rotation_start);
+      priv->rotation_start = 0;
+    }
 
-static void
-update_alignemnt_padding (HDStatusArea *status_area)
-{
-  HDStatusAreaPrivate *priv = status_area->priv;
-  gboolean portrait = is_portrait_mode (GTK_WIDGET (status_area));
-  guint left_right_padding;
+  /* First paint with all permanent items, once it is known how many
+   * are configured */
+  if (!priv->permanent_items_shown && priv->config_key_file &&
+      priv->n_permanent_items >= priv->n_configured_permanent_items)
+    {
+      priv->permanent_items_shown = TRUE;
+      hd_ready_notify (HD_READY_PERMANENT_ITEMS);
+    }
 
-  if (portrait)
-    left_right_padding = HILDON_MARGIN_DEFAULT;
-  else
-    left_right_padding = HILDON_MARGIN_DOUBLE;
+  hd_readahead_painted ();
 
-  gtk_alignment_set_padding (GTK_ALIGNMENT (priv->main_alignment),
-                             CUSTOM_MARGIN_9, CUSTOM_MARGIN_9,
-                             left_right_padding, left_right_padding);
+  return retval;
 }
 
 static void
@@ -602,14 +926,12 @@ hd_status_area_realize (GtkWidget *widget)
   Atom atom, wm_type;
   GdkPixmap *pixmap;
   cairo_t *cr;
+  gulong mark;
 
   screen = gtk_widget_get_screen (widget);
   gtk_widget_set_colormap (widget,
                            gdk_screen_get_rgba_colormap (screen));
 
-  g_signal_connect_swapped (screen, "size-changed",
-                            G_CALLBACK (update_alignemnt_padding),
-                            widget);
   update_alignemnt_padding (HD_STATUS_AREA (widget));
 
   gtk_widget_set_app_paintable (widget,
@@ -622,10 +944,12 @@ hd_status_area_realize (GtkWidget *widget)
 
   /* Set the _NET_WM_WINDOW_TYPE property to _HILDON_WM_WINDOW_TYPE_STATUS_AREA */
   display = gdk_drawable_get_display (widget->window);
+  mark = hd_x_audit_mark ();
   atom = gdk_x11_get_xatom_by_name_for_display (display,
                                                 "_NET_WM_WINDOW_TYPE");
   wm_type = gdk_x11_get_xatom_by_name_for_display (display,
                                                    "_HILDON_WM_WINDOW_TYPE_STATUS_AREA");
+  hd_x_audit_round_trips ("hd_status_area_realize", mark);
 
   XChangeProperty (GDK_WINDOW_XDISPLAY (widget->window),
                    GDK_WINDOW_XID (widget->window),
@@ -644,20 +968,6 @@ hd_status_area_realize (GtkWidget *widget)
   g_object_unref(pixmap);
 }
 
-static void
-hd_status_area_unrealize (GtkWidget *widget)
-{
-  GdkScreen *screen;
-
-  screen = gtk_widget_get_screen (widget);
-  g_signal_handlers_disconnect_by_func (screen,
-                                        update_alignemnt_padding,
-                                        HD_STATUS_AREA (widget));
-
-  GTK_WIDGET_CLASS (hd_status_area_parent_class)->unrealize (widget);
-}
-
-
 static void
 hd_status_area_map (GtkWidget *widget)
 {
@@ -675,6 +985,8 @@ hd_status_area_check_resize (GtkContainer *container)
   GtkWindow *window = GTK_WINDOW (container);
   GtkWidget *widget = GTK_WIDGET (container);
 
+  HD_PROBE1 (area_check_resize, window->configure_notify_received);
+
   /* Handle a resize based on a configure notify event
    *
    * Assign size and position of the widget with a call to
@@ -699,6 +1011,8 @@ hd_status_area_check_resize (GtkContainer *container)
        */
       gtk_widget_queue_resize (widget);
 
+      HD_PROBE (area_check_resize_done);
+
       return;
     }
 
@@ -718,6 +1032,8 @@ hd_status_area_check_resize (GtkContainer *container)
         {
           priv->resize_after_map = FALSE;
 
+          hd_metrics_counter_add (HD_METRICS_WINDOW_RESIZES, 1);
+
           /* Request the window manager to resize the window to
            * the required size (will result in a configure notify event
            * see above) */
@@ -728,6 +1044,8 @@ hd_status_area_check_resize (GtkContainer *container)
          configure notify event is triggered) */
       gtk_container_resize_children (GTK_CONTAINER (widget));
     }
+
+  HD_PROBE (area_check_resize_done);
 }
 
 static void
@@ -746,7 +1064,6 @@ hd_status_area_class_init (HDStatusAreaClass *klass)
   object_class->set_property = hd_status_area_set_property;
 
   widget_class->realize = hd_status_area_realize;
-  widget_class->unrealize = hd_status_area_unrealize;
   widget_class->map = hd_status_area_map;
   widget_class->expose_event = hd_status_area_expose_event;
 
@@ -757,14 +1074,14 @@ hd_status_area_class_init (HDStatusAreaClass *klass)
                                    g_param_spec_object ("plugin-manager",
                                                         "Plugin Manager",
                                                         "The plugin manager which should be used",
-                                                        HD_TYPE_PLUGIN_MANAGER,
+                                                        G_TYPE_OBJECT,
                                                         G_PARAM_WRITABLE | G_PARAM_CONSTRUCT_ONLY));
 
   g_type_class_add_private (klass, sizeof (HDStatusAreaPrivate));
 }
 
 GtkWidget *
-hd_status_area_new (HDPluginManager *plugin_manager)
+hd_status_area_new (GObject *plugin_manager)
 {
   GtkWidget *status_area;
 
@@ -55,7 +55,7 @@ struct _HDStatusAreaClass
 
 GType      hd_status_area_get_type (void) G_GNUC_CONST;
 
-GtkWidget *hd_status_area_new      (HDPluginManager *plugin_manager);
+GtkWidget *hd_status_area_new      (GObject         *plugin_manager);
 
 G_END_DECLS
 
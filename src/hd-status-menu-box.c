@@ -23,18 +23,30 @@
 #include <config.h>
 #endif
 
+#include "hd-metrics.h"
+#include "hd-probes.h"
 #include "hd-status-menu-box.h"
 
 /* UI Style guide */
 #define ITEM_HEIGHT 70
 #define ITEM_WIDTH 328
 
+/* Number of rows above and below the viewport which are allocated too */
+#define OVERSCAN_ROWS 1
+
 struct _HDStatusMenuBoxPrivate
 {
   GList *children;
 
   guint visible_items;
   guint columns;
+
+  /* Vertical adjustment of the viewport the box is placed in */
+  GtkAdjustment *vadjustment;
+
+  /* Rows allocated by the last hd_status_menu_box_place_children () */
+  gint first_row;
+  gint last_row;
 };
 
 
@@ -88,8 +100,13 @@ hd_status_menu_box_set_property (GObject      *object,
   switch (prop_id)
     {
     case PROP_COLUMNS:
-      priv->columns = g_value_get_uint (value);
-      gtk_widget_queue_resize (GTK_WIDGET (object));
+      /* Set again on each rotation, even if the columns are the same in
+       * both orientations */
+      if (priv->columns != g_value_get_uint (value))
+        {
+          priv->columns = g_value_get_uint (value);
+          gtk_widget_queue_resize (GTK_WIDGET (object));
+        }
       break;
 
     default:
@@ -201,23 +218,48 @@ hd_status_menu_box_set_child_property (GtkContainer *container,
 {
 }
 
+/* Rows intersecting the viewport, plus some overscan */
 static void
-hd_status_menu_box_size_allocate (GtkWidget     *widget,
-                                  GtkAllocation *allocation)
+hd_status_menu_box_get_rows (HDStatusMenuBox *box,
+                             gint            *first_row,
+                             gint            *last_row)
 {
-  HDStatusMenuBoxPrivate *priv;
+  HDStatusMenuBoxPrivate *priv = box->priv;
+  gint offset, top, bottom;
+
+  if (!priv->vadjustment)
+    {
+      *first_row = 0;
+      *last_row = G_MAXINT;
+      return;
+    }
+
+  offset = GTK_WIDGET (box)->allocation.y +
+           gtk_container_get_border_width (GTK_CONTAINER (box));
+  top = MAX ((gint) priv->vadjustment->value - offset, 0);
+  bottom = MAX ((gint) (priv->vadjustment->value + priv->vadjustment->page_size) - offset, 0);
+
+  *first_row = top / ITEM_HEIGHT - OVERSCAN_ROWS;
+  *last_row = (bottom + ITEM_HEIGHT - 1) / ITEM_HEIGHT - 1 + OVERSCAN_ROWS;
+}
+
+static void
+hd_status_menu_box_place_children (HDStatusMenuBox *box)
+{
+  HDStatusMenuBoxPrivate *priv = box->priv;
+  GtkWidget *widget = GTK_WIDGET (box);
+  GtkAllocation *allocation = &widget->allocation;
   guint border_width;
   GtkAllocation child_allocation = {0, 0, 0, 0};
   guint visible_children = 0;
   GList *c;
 
-  priv = HD_STATUS_MENU_BOX (widget)->priv;
-
   border_width = gtk_container_get_border_width (GTK_CONTAINER (widget));
 
-  /* chain up */
-  GTK_WIDGET_CLASS (hd_status_menu_box_parent_class)->size_allocate (widget,
-                                                                     allocation);
+  /* Only the rows intersecting the viewport (plus some overscan) are
+   * allocated, all other children are kept unmapped until they are
+   * scrolled into view */
+  hd_status_menu_box_get_rows (box, &priv->first_row, &priv->last_row);
 
   child_allocation.width = (allocation->width - (2 * border_width)) / priv->columns;
   child_allocation.height = ITEM_HEIGHT;
@@ -226,6 +268,8 @@ hd_status_menu_box_size_allocate (GtkWidget     *widget,
   for (c = priv->children; c; c = c->next)
     {
       HDStatusMenuBoxChild *info = c->data;
+      gint row;
+      gboolean on_screen;
 
       /* ignore hidden widgets */
       if (!GTK_WIDGET_VISIBLE (info->widget))
@@ -234,12 +278,134 @@ hd_status_menu_box_size_allocate (GtkWidget     *widget,
       child_allocation.x = allocation->x + border_width + (visible_children % priv->columns * child_allocation.width);
       child_allocation.y = allocation->y + border_width + (visible_children / priv->columns * ITEM_HEIGHT);
 
-      gtk_widget_size_allocate (info->widget, &child_allocation);
+      row = visible_children / priv->columns;
+      on_screen = row >= priv->first_row && row <= priv->last_row;
+
+      if (on_screen)
+        {
+          guint64 cpu_start = hd_metrics_plugin_enter (G_OBJECT (info->widget));
+
+          gtk_widget_size_allocate (info->widget, &child_allocation);
+
+          hd_metrics_plugin_leave (G_OBJECT (info->widget), HD_METRICS_PLUGIN_LAYOUT,
+                                   cpu_start);
+        }
+
+      if (gtk_widget_get_child_visible (info->widget) != on_screen)
+        gtk_widget_set_child_visible (info->widget, on_screen);
 
       visible_children++;
     }
 }
 
+static void
+hd_status_menu_box_size_allocate (GtkWidget     *widget,
+                                  GtkAllocation *allocation)
+{
+  HD_PROBE2 (menu_box_size_allocate, allocation->width, allocation->height);
+
+  /* chain up */
+  GTK_WIDGET_CLASS (hd_status_menu_box_parent_class)->size_allocate (widget,
+                                                                     allocation);
+
+  hd_status_menu_box_place_children (HD_STATUS_MENU_BOX (widget));
+
+  HD_PROBE2 (menu_box_size_allocate_done, allocation->width, allocation->height);
+}
+
+static void
+vadjustment_value_changed_cb (GtkAdjustment   *adjustment,
+                              HDStatusMenuBox *box)
+{
+  HDStatusMenuBoxPrivate *priv = box->priv;
+  gint first_row, last_row;
+
+  /* Otherwise the rows are computed in the next allocation */
+  if (!GTK_WIDGET_MAPPED (box))
+    return;
+
+  /* The allocated rows change only when a row boundary is crossed, then
+   * the children scrolled into view are placed within the current
+   * allocation of the box. Its size does not change on scroll, so there
+   * is no need to go through a resize of the whole menu */
+  hd_status_menu_box_get_rows (box, &first_row, &last_row);
+  if (first_row != priv->first_row || last_row != priv->last_row)
+    hd_status_menu_box_place_children (box);
+}
+
+static void
+hd_status_menu_box_set_vadjustment (HDStatusMenuBox *box,
+                                    GtkAdjustment   *vadjustment)
+{
+  HDStatusMenuBoxPrivate *priv = box->priv;
+
+  if (priv->vadjustment == vadjustment)
+    return;
+
+  if (priv->vadjustment)
+    {
+      g_signal_handlers_disconnect_by_func (priv->vadjustment,
+                                            vadjustment_value_changed_cb,
+                                            box);
+      priv->vadjustment = (g_object_unref (priv->vadjustment), NULL);
+    }
+
+  if (vadjustment)
+    {
+      priv->vadjustment = g_object_ref (vadjustment);
+      g_signal_connect (vadjustment, "value-changed",
+                        G_CALLBACK (vadjustment_value_changed_cb), box);
+    }
+
+  /* Place the children for the new scroll position */
+  if (vadjustment && GTK_WIDGET_MAPPED (box))
+    hd_status_menu_box_place_children (box);
+}
+
+static void
+viewport_vadjustment_notify_cb (GtkViewport     *viewport,
+                                GParamSpec      *pspec,
+                                HDStatusMenuBox *box)
+{
+  /* The viewport got new adjustments (e.g. gtk_viewport_set_vadjustment
+   * or ::set-scroll-adjustments) */
+  hd_status_menu_box_set_vadjustment (box,
+                                      gtk_viewport_get_vadjustment (viewport));
+}
+
+static void
+hd_status_menu_box_parent_set (GtkWidget *widget,
+                               GtkWidget *previous_parent)
+{
+  GtkWidget *parent = gtk_widget_get_parent (widget);
+
+  if (GTK_IS_VIEWPORT (previous_parent))
+    g_signal_handlers_disconnect_by_func (previous_parent,
+                                          viewport_vadjustment_notify_cb,
+                                          widget);
+
+  /* Track the scroll position of the viewport (see
+   * hildon_pannable_area_add_with_viewport) */
+  if (GTK_IS_VIEWPORT (parent))
+    {
+      g_signal_connect (parent, "notify::vadjustment",
+                        G_CALLBACK (viewport_vadjustment_notify_cb), widget);
+      hd_status_menu_box_set_vadjustment (HD_STATUS_MENU_BOX (widget),
+                                          gtk_viewport_get_vadjustment (GTK_VIEWPORT (parent)));
+    }
+  else
+    hd_status_menu_box_set_vadjustment (HD_STATUS_MENU_BOX (widget),
+                                        NULL);
+}
+
+static void
+hd_status_menu_box_dispose (GObject *object)
+{
+  hd_status_menu_box_set_vadjustment (HD_STATUS_MENU_BOX (object), NULL);
+
+  G_OBJECT_CLASS (hd_status_menu_box_parent_class)->dispose (object);
+}
+
 static void
 hd_status_menu_box_size_request (GtkWidget      *widget,
                                  GtkRequisition *requisition)
@@ -258,6 +424,7 @@ hd_status_menu_box_size_request (GtkWidget      *widget,
     {
       HDStatusMenuBoxChild *info = c->data;
       GtkRequisition child_requisition;
+      guint64 cpu_start;
 
       if (!GTK_WIDGET_VISIBLE (info->widget))
         continue;
@@ -265,7 +432,10 @@ hd_status_menu_box_size_request (GtkWidget      *widget,
       visible_children++;
 
       /* there are some widgets which need a size request */
+      cpu_start = hd_metrics_plugin_enter (G_OBJECT (info->widget));
       gtk_widget_size_request (info->widget, &child_requisition);
+      hd_metrics_plugin_leave (G_OBJECT (info->widget), HD_METRICS_PLUGIN_LAYOUT,
+                               cpu_start);
     }
 
   /* Update ::visible-items property if required */
@@ -288,6 +458,7 @@ hd_status_menu_box_class_init (HDStatusMenuBoxClass *klass)
   GtkContainerClass *container_class = GTK_CONTAINER_CLASS (klass);
   GtkWidgetClass *widget_class = GTK_WIDGET_CLASS (klass);
 
+  object_class->dispose = hd_status_menu_box_dispose;
   object_class->get_property = hd_status_menu_box_get_property;
   object_class->set_property = hd_status_menu_box_set_property;
 
@@ -300,6 +471,7 @@ hd_status_menu_box_class_init (HDStatusMenuBoxClass *klass)
 
   widget_class->size_allocate = hd_status_menu_box_size_allocate;
   widget_class->size_request = hd_status_menu_box_size_request;
+  widget_class->parent_set = hd_status_menu_box_parent_set;
 
   g_object_class_install_property (object_class,
                                    PROP_VISIBLE_ITEMS,
@@ -408,3 +580,58 @@ hd_status_menu_box_reorder_child (HDStatusMenuBox *box,
         }
     }
 }
+
+static gint
+cmp_children (gconstpointer a,
+              gconstpointer b)
+{
+  guint x = ((const HDStatusMenuBoxChild *) a)->priority;
+  guint y = ((const HDStatusMenuBoxChild *) b)->priority;
+
+  return x < y ? -1 : (x > y ? 1 : 0);
+}
+
+/**
+ * hd_status_menu_box_reorder_children:
+ * @box: a #HDStatusMenuBox
+ * @func: returns the new position of a child
+ * @data: data passed to @func
+ *
+ * Sets the positions of all children at once. The children list is
+ * sorted once and the box is resized once, only if a child moved.
+ **/
+void
+hd_status_menu_box_reorder_children (HDStatusMenuBox             *box,
+                                    HDStatusMenuBoxPositionFunc  func,
+                                    gpointer                     data)
+{
+  HDStatusMenuBoxPrivate *priv;
+  gboolean moved = FALSE;
+  GList *c;
+
+  g_return_if_fail (HD_IS_STATUS_MENU_BOX (box));
+  g_return_if_fail (func != NULL);
+
+  priv = box->priv;
+
+  for (c = priv->children; c; c = c->next)
+    {
+      HDStatusMenuBoxChild *info = c->data;
+      guint position = func (info->widget, data);
+
+      if (info->priority != position)
+        {
+          info->priority = position;
+          moved = TRUE;
+        }
+    }
+
+  if (!moved)
+    return;
+
+  /* Stable, children with the same priority keep their order */
+  priv->children = g_list_sort (priv->children, cmp_children);
+
+  if (GTK_WIDGET_VISIBLE (box))
+    gtk_widget_queue_resize (GTK_WIDGET (box));
+}
@@ -37,6 +37,9 @@ typedef struct _HDStatusMenuBox        HDStatusMenuBox;
 typedef struct _HDStatusMenuBoxClass   HDStatusMenuBoxClass;
 typedef struct _HDStatusMenuBoxPrivate HDStatusMenuBoxPrivate;
 
+typedef guint (*HDStatusMenuBoxPositionFunc) (GtkWidget *child,
+                                              gpointer   data);
+
 struct _HDStatusMenuBox
 {
   GtkContainer            parent;
@@ -59,6 +62,9 @@ void       hd_status_menu_box_pack          (HDStatusMenuBox *box,
 void       hd_status_menu_box_reorder_child (HDStatusMenuBox *box,
                                              GtkWidget       *child,
                                              guint            position);
+void       hd_status_menu_box_reorder_children (HDStatusMenuBox             *box,
+                                                HDStatusMenuBoxPositionFunc  func,
+                                                gpointer                     data);
 G_END_DECLS
 
 #endif /* __HD_STATUS_MENU_BOX_H__ */
@@ -31,4 +31,16 @@
 
 #define HD_STATUS_MENU_CONFIG_KEY_POSITION       "X-Status-Menu-Position"
 
+/* Milliseconds to wait for a plugin with asynchronous initialization */
+#define HD_STATUS_MENU_CONFIG_KEY_READY_DEADLINE "X-Status-Menu-Ready-Deadline"
+
+/* Plugin configuration read before the plugin manager runs */
+#define HD_STATUS_MENU_CONFIG_FILE               "status-menu.conf"
+#define HD_STATUS_MENU_CONFIG_PLUGIN_MANAGER_GROUP "X-PluginManager"
+#define HD_STATUS_MENU_CONFIG_KEY_LOAD_ALL_PLUGINS "X-Load-All-Plugins"
+#define HD_STATUS_MENU_CONFIG_PLUGINS_FILE       "status-menu.plugins"
+#define HD_STATUS_MENU_CONFIG_KEY_DESKTOP_FILE   "X-Desktop-File"
+#define HD_STATUS_MENU_CONFIG_DESKTOP_GROUP      "Desktop Entry"
+#define HD_STATUS_MENU_CONFIG_KEY_LIBRARY        "X-Path"
+
 #endif
@@ -38,9 +38,16 @@
 
 #include <gconf/gconf-client.h>
 
+#include "hd-metrics.h"
+#include "hd-plugin-ready.h"
+#include "hd-probes.h"
+#include "hd-recorder.h"
+#include "hd-screen.h"
 #include "hd-status-menu.h"
 #include "hd-status-menu-box.h"
 #include "hd-status-menu-config.h"
+#include "hd-trace.h"
+#include "hd-x-audit.h"
 
 /**
  * SECTION:hdstatusmenu
@@ -77,18 +84,45 @@ enum
   PROP_PLUGIN_MANAGER
 };
 
+typedef struct _HDStatusMenuGeometry HDStatusMenuGeometry;
+struct _HDStatusMenuGeometry
+{
+  gint  x;
+  gint  pannable_width;
+  gint  pannable_height;
+  guint columns;
+};
+
 struct _HDStatusMenuPrivate
 {
   GtkWidget       *box;
   GtkWidget       *pannable;
 
-  HDPluginManager *plugin_manager;
+  GObject         *plugin_manager;
+  GKeyFile        *config_key_file;
 
   GConfClient     *gconf_client;
 
+  HDScreen        *screen;
+
   gboolean         pressed_outside;
 
   gboolean         portrait;
+
+  /* Layout was done by hd_status_menu_prepare () for the orientation
+   * in prepared_portrait */
+  gboolean         prepared;
+  gboolean         prepared_portrait;
+
+  /* Time of the tap which opens the menu, 0 after the first paint */
+  guint64          open_start;
+
+  guint            visible_items;
+  gint             rows;
+  gint             rows_portrait;
+
+  /* Cached geometry, indexed by portrait */
+  HDStatusMenuGeometry geometry[2];
 };
 
 #define HD_STATUS_MENU_GET_PRIVATE(obj) (G_TYPE_INSTANCE_GET_PRIVATE ((obj), HD_TYPE_STATUS_MENU, HDStatusMenuPrivate));
@@ -96,10 +130,9 @@ struct _HDStatusMenuPrivate
 G_DEFINE_TYPE (HDStatusMenu, hd_status_menu, GTK_TYPE_WINDOW);
 
 static void
-notify_visible_items_cb (HDStatusMenu *status_menu)
+read_number_of_rows (HDStatusMenu *status_menu)
 {
   HDStatusMenuPrivate *priv = status_menu->priv;
-  guint visible_items;
   int rows = NUMBER_OF_ROWS;
   int rows_portrait = NUMBER_OF_ROWS_PORTRAIT;
 
@@ -123,28 +156,73 @@ notify_visible_items_cb (HDStatusMenu *status_menu)
       gconf_value_free (value);
     }
 
+  priv->rows = rows;
+  priv->rows_portrait = rows_portrait;
+}
+
+/* Compute the geometry of the menu for both orientations, so a rotation
+ * only has to apply the precomputed values (see update_portrait) */
+static void
+update_geometry (HDStatusMenu *status_menu)
+{
+  HDStatusMenuPrivate *priv = status_menu->priv;
+  HDStatusMenuGeometry *landscape = &priv->geometry[FALSE];
+  HDStatusMenuGeometry *portrait = &priv->geometry[TRUE];
+  gint landscape_screen_width;
+  gint portrait_screen_width;
+
+  landscape_screen_width = MAX (hd_screen_get_width (priv->screen),
+                                hd_screen_get_height (priv->screen));
+  portrait_screen_width = MIN (hd_screen_get_width (priv->screen),
+                               hd_screen_get_height (priv->screen));
+
+  landscape->columns = 2;
+  landscape->pannable_width = STATUS_MENU_PANNABLE_WIDTH_LANDSCAPE;
+  landscape->pannable_height = MIN (MAX ((priv->visible_items + 1) / 2, 1), priv->rows) * STATUS_MENU_ITEM_HEIGHT;
+  landscape->x = (landscape_screen_width - STATUS_MENU_PANNABLE_WIDTH_LANDSCAPE) / 2;
+
+  portrait->columns = 1;
+  portrait->pannable_width = STATUS_MENU_PANNABLE_WIDTH_PORTRAIT;
+  portrait->pannable_height = MIN (MAX (priv->visible_items, 1), priv->rows_portrait) * STATUS_MENU_ITEM_HEIGHT;
+  portrait->x = (portrait_screen_width - STATUS_MENU_PANNABLE_WIDTH_PORTRAIT) / 2;
+}
+
+static void
+update_pannable_size (HDStatusMenu *status_menu)
+{
+  HDStatusMenuPrivate *priv = status_menu->priv;
+  HDStatusMenuGeometry *geometry = &priv->geometry[priv->portrait];
+
+  gtk_widget_set_size_request (priv->pannable,
+                               geometry->pannable_width,
+                               geometry->pannable_height);
+}
+
+static void
+notify_visible_items_cb (HDStatusMenu *status_menu)
+{
+  HDStatusMenuPrivate *priv = status_menu->priv;
+
   g_object_get (priv->box,
-                "visible-items", &visible_items,
+                "visible-items", &priv->visible_items,
                 NULL);
 
-  if (priv->portrait)
-    {
-      gtk_widget_set_size_request (priv->pannable,
-                                   STATUS_MENU_PANNABLE_WIDTH_PORTRAIT,
-                                   MIN (MAX (visible_items, 1), rows_portrait) * STATUS_MENU_ITEM_HEIGHT);
-    }
-  else
-    {
-      gtk_widget_set_size_request (priv->pannable,
-                                   STATUS_MENU_PANNABLE_WIDTH_LANDSCAPE,
-                                   MIN (MAX ((visible_items + 1) / 2, 1), rows) * STATUS_MENU_ITEM_HEIGHT);
-    }
+  hd_metrics_counter_set (HD_METRICS_MENU_ITEMS, priv->visible_items);
+
+  update_geometry (status_menu);
+  update_pannable_size (status_menu);
 }
 
 static DBusHandlerResult
 hd_status_menu_dbus_handler (DBusConnection *conn,
                              DBusMessage *msg, void *data)
 {
+  guint64 cpu_start = hd_metrics_get_cpu_time ();
+
+  if (dbus_message_get_type (msg) == DBUS_MESSAGE_TYPE_SIGNAL &&
+      dbus_message_has_interface (msg, DSME_SIGNAL_INTERFACE))
+    hd_trace_record (HD_TRACE_DSME, "%s", dbus_message_get_member (msg));
+
   if (dbus_message_is_signal(msg, DSME_SIGNAL_INTERFACE,
                              DSME_SHUTDOWN_SIGNAL_NAME))
     {
@@ -154,6 +232,9 @@ hd_status_menu_dbus_handler (DBusConnection *conn,
       exit (0);
     }
 
+  hd_metrics_counter_add (HD_METRICS_DBUS_FILTER_CPU,
+                          hd_metrics_get_cpu_time () - cpu_start);
+
   return DBUS_HANDLER_RESULT_NOT_YET_HANDLED;
 }
 
@@ -163,47 +244,10 @@ hd_status_menu_on_gconf_value_changed (GConfClient *client G_GNUC_UNUSED,
                                        GConfEntry *entry  G_GNUC_UNUSED,
                                        HDStatusMenu *status_menu)
 {
-  HDStatusMenuPrivate *priv = HD_STATUS_MENU_GET_PRIVATE (status_menu);
-  guint visible_items;
-  int rows = NUMBER_OF_ROWS;
-  int rows_portrait = NUMBER_OF_ROWS_PORTRAIT;
-
-  /* If gconf default to 0 or the user sets the value to a negative integer
-     use a hardcoded value, then save that in gconf) */
-  if (rows <= 0)
-    {
-      GConfValue *value = gconf_value_new (GCONF_VALUE_INT);
-      rows = 6;
-      gconf_value_set_int (value, rows);
-      gconf_client_set (priv->gconf_client, NUMBER_OF_ROWS_GCONF_KEY, value, NULL);
-      gconf_value_free (value);
-    }
-
-  if (rows_portrait <= 0)
-    {
-      GConfValue *value = gconf_value_new (GCONF_VALUE_INT);
-      rows_portrait = 8;
-      gconf_value_set_int (value, rows_portrait);
-      gconf_client_set (priv->gconf_client, NUMBER_OF_ROWS_PORTRAIT_GCONF_KEY, value, NULL);
-      gconf_value_free (value);
-    }
+  read_number_of_rows (status_menu);
 
-  g_object_get (priv->box,
-                "visible-items", &visible_items,
-                NULL);
-
-  if (priv->portrait)
-    {
-      gtk_widget_set_size_request (priv->pannable,
-                                   STATUS_MENU_PANNABLE_WIDTH_PORTRAIT,
-                                   MIN (MAX (visible_items, 1), rows_portrait) * STATUS_MENU_ITEM_HEIGHT);
-    }
-  else
-    {
-      gtk_widget_set_size_request (priv->pannable,
-                                   STATUS_MENU_PANNABLE_WIDTH_LANDSCAPE,
-                                   MIN (MAX ((visible_items + 1) / 2, 1), rows) * STATUS_MENU_ITEM_HEIGHT);
-    }
+  update_geometry (status_menu);
+  update_pannable_size (status_menu);
 }
 
 static void
@@ -235,6 +279,8 @@ hd_status_menu_init (HDStatusMenu *status_menu)
                                   NULL, NULL);
     }
 
+  priv->screen = hd_screen_get ();
+
   /* Initialize GConfClient */
   priv->gconf_client = gconf_client_get_default ();
 
@@ -247,6 +293,7 @@ hd_status_menu_init (HDStatusMenu *status_menu)
   gconf_client_notify_add (priv->gconf_client, NUMBER_OF_ROWS_PORTRAIT_GCONF_KEY,
                            (gpointer) hd_status_menu_on_gconf_value_changed,
                            status_menu, NULL, NULL);
+  read_number_of_rows (status_menu);
 
   /* Create widgets */
   priv->box = hd_status_menu_box_new ();
@@ -301,13 +348,31 @@ hd_status_menu_dispose (GObject *object)
       priv->gconf_client = NULL;
     }
 
+  if (priv->screen)
+    {
+      g_object_unref (priv->screen);
+      priv->screen = NULL;
+    }
+
   G_OBJECT_CLASS (hd_status_menu_parent_class)->dispose (object);
 }
 
+static GKeyFile *
+get_plugin_config_key_file (HDStatusMenu *status_menu)
+{
+  HDStatusMenuPrivate *priv = status_menu->priv;
+
+  if (HD_IS_PLUGIN_MANAGER (priv->plugin_manager))
+    return hd_plugin_manager_get_plugin_config_key_file (HD_PLUGIN_MANAGER (priv->plugin_manager));
+
+  /* Stand-ins only provide the configuration through
+   * ::items-configuration-loaded */
+  return priv->config_key_file;
+}
+
 static void
-hd_status_menu_plugin_added_cb (HDPluginManager *plugin_manager,
-                                GObject         *plugin,
-                                HDStatusMenu    *status_menu)
+add_menu_plugin (GObject      *plugin,
+                 HDStatusMenu *status_menu)
 {
   HDStatusMenuPrivate *priv = status_menu->priv;
   gchar *plugin_id;
@@ -315,12 +380,8 @@ hd_status_menu_plugin_added_cb (HDPluginManager *plugin_manager,
   guint position;
   GError *error = NULL;
 
-  /* Plugin must be a HDStatusMenuItem */
-  if (!HD_IS_STATUS_MENU_ITEM (plugin))
-    return;
-
   /* Read position in Status Menu from plugin configuration */
-  keyfile = hd_plugin_manager_get_plugin_config_key_file (plugin_manager);
+  keyfile = get_plugin_config_key_file (status_menu);
   plugin_id = hd_plugin_item_get_plugin_id (HD_PLUGIN_ITEM (plugin));
 
   position = (guint) g_key_file_get_integer (keyfile,
@@ -343,7 +404,25 @@ hd_status_menu_plugin_added_cb (HDPluginManager *plugin_manager,
 }
 
 static void
-hd_status_menu_plugin_removed_cb (HDPluginManager *plugin_manager,
+hd_status_menu_plugin_added_cb (GObject         *plugin_manager,
+                                GObject         *plugin,
+                                HDStatusMenu    *status_menu)
+{
+  /* Plugin must be a HDStatusMenuItem */
+  if (!HD_IS_STATUS_MENU_ITEM (plugin))
+    return;
+
+  /* Plugins with asynchronous initialization are packed when ready */
+  if (hd_plugin_ready_defer (plugin,
+                             (HDPluginReadyFunc) add_menu_plugin,
+                             status_menu))
+    return;
+
+  add_menu_plugin (plugin, status_menu);
+}
+
+static void
+hd_status_menu_plugin_removed_cb (GObject         *plugin_manager,
                                   GObject         *plugin,
                                   HDStatusMenu    *status_menu)
 {
@@ -353,13 +432,24 @@ hd_status_menu_plugin_removed_cb (HDPluginManager *plugin_manager,
   if (!HD_IS_STATUS_MENU_ITEM (plugin))
     return;
 
+  /* Not packed yet, destroy it as the box would have */
+  if (hd_plugin_ready_cancel (plugin,
+                              (HDPluginReadyFunc) add_menu_plugin,
+                              status_menu))
+    {
+      g_object_ref_sink (plugin);
+      gtk_widget_destroy (GTK_WIDGET (plugin));
+      g_object_unref (plugin);
+      return;
+    }
+
   /* Remove the plugin from the container (and destroy it) */
   gtk_container_remove (GTK_CONTAINER (priv->box), GTK_WIDGET (plugin));
 }
 
-static void
-update_position (GtkWidget *child,
-                 GKeyFile  *keyfile)
+static guint
+get_position (GtkWidget *child,
+              GKeyFile  *keyfile)
 {
   gchar *plugin_id;
   guint position;
@@ -381,20 +471,22 @@ update_position (GtkWidget *child,
       position = G_MAXUINT;
     }
 
-  /* Reorder Child */
-  hd_status_menu_box_reorder_child (HD_STATUS_MENU_BOX (gtk_widget_get_parent (child)),
-                                    child,
-                                    position);
+  return position;
 }
 
 static void
-hd_status_menu_items_configuration_loaded_cb (HDPluginManager *plugin_manager,
+hd_status_menu_items_configuration_loaded_cb (GObject         *plugin_manager,
                                                GKeyFile        *key_file,
                                                HDStatusMenu    *status_menu)
 {
   HDStatusMenuPrivate *priv = status_menu->priv;
 
-  gtk_container_foreach (GTK_CONTAINER (priv->box), (GtkCallback) update_position, key_file);
+  priv->config_key_file = key_file;
+
+  /* Only moved children are reordered, in one layout pass */
+  hd_status_menu_box_reorder_children (HD_STATUS_MENU_BOX (priv->box),
+                                       (HDStatusMenuBoxPositionFunc) get_position,
+                                       key_file);
 }
 
 static void
@@ -409,6 +501,8 @@ hd_status_menu_set_property (GObject      *object,
     {
     case PROP_PLUGIN_MANAGER:
       /* The property is CONSTRUCT_ONLY so there is no value yet */
+      /* Either a HDPluginManager or a stand-in emitting the same
+       * signals (see HDStubPluginManager) */
       priv->plugin_manager = g_value_dup_object (value);
       if (priv->plugin_manager != NULL)
         {
@@ -428,56 +522,49 @@ hd_status_menu_set_property (GObject      *object,
     }
 }
 
-static gboolean
-is_portrait_mode (GtkWidget *widget)
-{
-  GdkScreen *screen;
-
-  screen = gtk_widget_get_screen (widget);
-
-  return gdk_screen_get_height (screen) > gdk_screen_get_width (screen);
-}
-
 static void
 update_portrait (HDStatusMenu *status_menu)
 {
   HDStatusMenuPrivate *priv = status_menu->priv;
-  GdkScreen *screen;
-  gint window_width;
+  HDStatusMenuGeometry *geometry;
 
-  priv->portrait = is_portrait_mode (GTK_WIDGET (status_menu));
-
-  if (priv->portrait)
-    window_width = STATUS_MENU_PANNABLE_WIDTH_PORTRAIT;
-  else
-    window_width = STATUS_MENU_PANNABLE_WIDTH_LANDSCAPE;
+  priv->portrait = hd_screen_is_portrait (priv->screen);
+  geometry = &priv->geometry[priv->portrait];
 
   /* Horizontally center menu */
-  screen = gtk_widget_get_screen (GTK_WIDGET (status_menu));
   gtk_window_move (GTK_WINDOW (GTK_WIDGET (status_menu)),
-                   (gdk_screen_get_width (screen) - window_width) / 2, 0);
+                   geometry->x, 0);
 
   g_object_set (priv->box,
-                "columns", priv->portrait ? 1 : 2,
+                "columns", geometry->columns,
                 NULL);
 
-  notify_visible_items_cb (status_menu);
+  update_pannable_size (status_menu);
 
   hildon_pannable_area_jump_to (HILDON_PANNABLE_AREA (priv->pannable),
                                 0, 0);
 }
 
+static void
+orientation_changed_cb (HDStatusMenu *status_menu)
+{
+  /* The screen width of each orientation could have changed */
+  update_geometry (status_menu);
+  update_portrait (status_menu);
+}
+
 static void
 hd_status_menu_realize (GtkWidget *widget)
 {
-  GdkScreen *screen;
+  HDStatusMenuPrivate *priv = HD_STATUS_MENU (widget)->priv;
   GdkDisplay *display;
   Atom atom, wm_type;
+  gulong mark;
 
-  screen = gtk_widget_get_screen (widget);
-  g_signal_connect_swapped (screen, "size-changed",
-                            G_CALLBACK (update_portrait),
+  g_signal_connect_swapped (priv->screen, "orientation-changed",
+                            G_CALLBACK (orientation_changed_cb),
                             widget);
+  update_geometry (HD_STATUS_MENU (widget));
   update_portrait (HD_STATUS_MENU (widget));
 
   GTK_WIDGET_CLASS (hd_status_menu_parent_class)->realize (widget);
@@ -487,10 +574,12 @@ hd_status_menu_realize (GtkWidget *widget)
 
   /* Set the _NET_WM_WINDOW_TYPE property to _HILDON_WM_WINDOW_TYPE_STATUS_MENU */
   display = gdk_drawable_get_display (widget->window);
+  mark = hd_x_audit_mark ();
   atom = gdk_x11_get_xatom_by_name_for_display (display,
                                                 "_NET_WM_WINDOW_TYPE");
   wm_type = gdk_x11_get_xatom_by_name_for_display (display,
                                                    "_HILDON_WM_WINDOW_TYPE_STATUS_MENU");
+  hd_x_audit_round_trips ("hd_status_menu_realize", mark);
 
   XChangeProperty (GDK_WINDOW_XDISPLAY (widget->window),
                    GDK_WINDOW_XID (widget->window),
@@ -501,11 +590,10 @@ hd_status_menu_realize (GtkWidget *widget)
 static void
 hd_status_menu_unrealize (GtkWidget *widget)
 {
-  GdkScreen *screen;
+  HDStatusMenuPrivate *priv = HD_STATUS_MENU (widget)->priv;
 
-  screen = gtk_widget_get_screen (widget);
-  g_signal_handlers_disconnect_by_func (screen,
-                                        update_portrait,
+  g_signal_handlers_disconnect_by_func (priv->screen,
+                                        orientation_changed_cb,
                                         HD_STATUS_MENU (widget));
 
   GTK_WIDGET_CLASS (hd_status_menu_parent_class)->unrealize (widget);
@@ -514,8 +602,68 @@ hd_status_menu_unrealize (GtkWidget *widget)
 static void
 hd_status_menu_map (GtkWidget *widget)
 {
+  HDStatusMenuPrivate *priv = HD_STATUS_MENU (widget)->priv;
+
+  /* Not opened by a tap on the Status Area */
+  if (!priv->open_start)
+    priv->open_start = hd_metrics_get_time ();
+  hd_metrics_counter_add (HD_METRICS_MENU_OPENS, 1);
+  hd_recorder_record (HD_RECORDER_MENU_OPEN, priv->portrait);
+  HD_PROBE1 (menu_map, priv->portrait);
+
+  hd_x_audit_begin (HD_X_AUDIT_MENU_OPEN);
+
   GTK_WIDGET_CLASS (hd_status_menu_parent_class)->map (widget);
-  update_portrait (HD_STATUS_MENU (widget));
+
+  if (priv->prepared &&
+      priv->prepared_portrait == hd_screen_is_portrait (priv->screen))
+    {
+      /* Layout was already done on button press, only move the pannable
+       * up to the first item again (shows the panning indicator) */
+      hildon_pannable_area_jump_to (HILDON_PANNABLE_AREA (priv->pannable),
+                                    0, 0);
+    }
+  else
+    update_portrait (HD_STATUS_MENU (widget));
+  priv->prepared = FALSE;
+
+  hd_x_audit_end ();
+}
+
+static void
+hd_status_menu_unmap (GtkWidget *widget)
+{
+  HDStatusMenuPrivate *priv = HD_STATUS_MENU (widget)->priv;
+
+  /* Closed before the first paint */
+  priv->prepared = FALSE;
+  priv->open_start = 0;
+
+  hd_recorder_record (HD_RECORDER_MENU_CLOSE, 0);
+
+  GTK_WIDGET_CLASS (hd_status_menu_parent_class)->unmap (widget);
+}
+
+static gboolean
+hd_status_menu_expose_event (GtkWidget      *widget,
+                             GdkEventExpose *event)
+{
+  HDStatusMenuPrivate *priv = HD_STATUS_MENU (widget)->priv;
+  gboolean retval;
+
+  retval = GTK_WIDGET_CLASS (hd_status_menu_parent_class)->expose_event (widget,
+                                                                         event);
+
+  /* First paint after the menu was opened */
+  if (priv->open_start)
+    {
+      hd_metrics_add_latency (priv->portrait ? HD_METRICS_MENU_OPEN_PORTRAIT
+                                             : HD_METRICS_MENU_OPEN_LANDSCAPE,
+                              hd_metrics_get_time () - priv->open_start);
+      priv->open_start = 0;
+    }
+
+  return retval;
 }
 
 static void
@@ -524,6 +672,8 @@ hd_status_menu_check_resize (GtkContainer *container)
   GtkWindow *window = GTK_WINDOW (container);
   GtkWidget *widget = GTK_WIDGET (container);
 
+  HD_PROBE1 (menu_check_resize, window->configure_notify_received);
+
   /* Handle a resize based on a configure notify event
    *
    * Assign size and position of the widget with a call to
@@ -548,6 +698,8 @@ hd_status_menu_check_resize (GtkContainer *container)
        */
       gtk_widget_queue_resize (widget);
 
+      HD_PROBE (menu_check_resize_done);
+
       return;
     }
 
@@ -560,13 +712,21 @@ hd_status_menu_check_resize (GtkContainer *container)
 
       /* Request the window manager to resize the window to
        * the required size (will result in a configure notify event
-       * see above) */
-      gdk_window_resize (widget->window, req.width, req.height);
+       * see above). Skipped if the size did not change, that would
+       * only be a round trip to the window manager */
+      if (req.width != widget->allocation.width ||
+          req.height != widget->allocation.height)
+        {
+          hd_metrics_counter_add (HD_METRICS_WINDOW_RESIZES, 1);
+          gdk_window_resize (widget->window, req.width, req.height);
+        }
 
       /* Resize children (also if size not changed and so no
        * configure notify event is triggered) */
       gtk_container_resize_children (GTK_CONTAINER (widget));
     }
+
+  HD_PROBE (menu_check_resize_done);
 }
 
 static void
@@ -582,6 +742,8 @@ hd_status_menu_class_init (HDStatusMenuClass *klass)
   widget_class->realize = hd_status_menu_realize;
   widget_class->unrealize = hd_status_menu_unrealize;
   widget_class->map = hd_status_menu_map;
+  widget_class->unmap = hd_status_menu_unmap;
+  widget_class->expose_event = hd_status_menu_expose_event;
 
   container_class->check_resize = hd_status_menu_check_resize;
 
@@ -590,22 +752,90 @@ hd_status_menu_class_init (HDStatusMenuClass *klass)
                                    g_param_spec_object ("plugin-manager",
                                                         "Plugin Manager",
                                                         "The plugin manager which should be used",
-                                                        HD_TYPE_PLUGIN_MANAGER,
+                                                        G_TYPE_OBJECT,
                                                         G_PARAM_WRITABLE | G_PARAM_CONSTRUCT_ONLY));
 
   g_type_class_add_private (klass, sizeof (HDStatusMenuPrivate));
 }
 
+/**
+ * hd_status_menu_prepare:
+ * @status_menu: a #HDStatusMenu
+ *
+ * Prepare the hidden Status Menu to be shown: resolve the style, lay out
+ * the menu for the current orientation and process pending size requests
+ * of the items. Called when the Status Area is pressed so that showing the
+ * menu on release only has to map it.
+ **/
+void
+hd_status_menu_prepare (HDStatusMenu *status_menu)
+{
+  HDStatusMenuPrivate *priv;
+  GtkWidget *widget;
+  GtkRequisition req;
+
+  g_return_if_fail (HD_IS_STATUS_MENU (status_menu));
+
+  priv = status_menu->priv;
+  widget = GTK_WIDGET (status_menu);
+
+  if (GTK_WIDGET_VISIBLE (widget))
+    return;
+
+  priv->open_start = hd_metrics_get_time ();
+
+  hd_x_audit_begin (HD_X_AUDIT_MENU_OPEN);
+
+  /* Realizing resolves the style and calls update_portrait () */
+  if (GTK_WIDGET_REALIZED (widget))
+    update_portrait (status_menu);
+  else
+    gtk_widget_realize (widget);
+
+  /* Update ::visible-items of the box and so the size of the pannable */
+  gtk_widget_size_request (widget, &req);
+
+  priv->prepared = TRUE;
+  priv->prepared_portrait = priv->portrait;
+
+  hd_x_audit_end ();
+}
+
+/**
+ * hd_status_menu_unprepare:
+ * @status_menu: a #HDStatusMenu
+ *
+ * Drop the state set up by hd_status_menu_prepare () when the menu is not
+ * shown after all (e.g. the grab of the press was broken), so a later map
+ * neither skips the layout nor reports the tap as open latency.
+ **/
+void
+hd_status_menu_unprepare (HDStatusMenu *status_menu)
+{
+  HDStatusMenuPrivate *priv;
+
+  g_return_if_fail (HD_IS_STATUS_MENU (status_menu));
+
+  priv = status_menu->priv;
+
+  if (GTK_WIDGET_MAPPED (status_menu))
+    return;
+
+  priv->prepared = FALSE;
+  priv->open_start = 0;
+}
+
 /**
  * hd_status_menu_new:
- * @plugin_manager a #HDPluginManager used to load the plugins
+ * @plugin_manager a #HDPluginManager used to load the plugins (or a stand-in
+ *                  emitting the same signals)
  *
  * Create a new Status Menu window.
  *
  * Returns: a new #HDStatusMenu.
  **/
 GtkWidget *
-hd_status_menu_new (HDPluginManager *plugin_manager)
+hd_status_menu_new (GObject *plugin_manager)
 {
   GtkWidget *status_menu;
 
@@ -56,9 +56,12 @@ struct _HDStatusMenuClass
   GtkWindowClass parent_class;
 };
 
-GType      hd_status_menu_get_type (void) G_GNUC_CONST;
+GType      hd_status_menu_get_type  (void) G_GNUC_CONST;
 
-GtkWidget *hd_status_menu_new      (HDPluginManager *plugin_manager);
+GtkWidget *hd_status_menu_new       (GObject         *plugin_manager);
+
+void       hd_status_menu_prepare   (HDStatusMenu    *status_menu);
+void       hd_status_menu_unprepare (HDStatusMenu    *status_menu);
 
 G_END_DECLS
 
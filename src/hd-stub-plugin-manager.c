@@ -0,0 +1,598 @@
+/*
+ * This file is part of hildon-status-menu
+ * 
+ * Copyright (C) 2010 Nokia Corporation.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * version 2.1 as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <libhildondesktop/libhildondesktop.h>
+
+#include <string.h>
+
+#include "hd-status-menu-config.h"
+#include "hd-stub-plugin-manager.h"
+
+/* The script is a key file with one group per plugin. The group name is the
+ * plugin id and the configuration keys of status-menu.plugins (positions
+ * and permanent items) are used as they are. Additional keys:
+ *
+ *   X-Stub-Type=status-area|status-menu  kind of plugin (status-area)
+ *   X-Stub-Add-Time=<ms>                 time after run to add it (0)
+ *   X-Stub-Remove-Time=<ms>              time after run to remove it (never)
+ *   X-Stub-Icon=<icon name>              Status Area icon (a plain square
+ *                                        if not in the icon theme)
+ *   X-Stub-Icon-Interval=<ms>            toggle the icon at this interval
+ *   X-Stub-Churn-Interval=<ms>           remove and add it again and again
+ *                                        at this interval (0, off)
+ *
+ * Plugins with the same add time are added in the order of the script.
+ * ::plugins-loaded is emitted once each plugin was added for the first
+ * time.
+ */
+#define HD_STUB_KEY_TYPE          "X-Stub-Type"
+#define HD_STUB_KEY_ADD_TIME      "X-Stub-Add-Time"
+#define HD_STUB_KEY_REMOVE_TIME   "X-Stub-Remove-Time"
+#define HD_STUB_KEY_ICON          "X-Stub-Icon"
+#define HD_STUB_KEY_ICON_INTERVAL "X-Stub-Icon-Interval"
+#define HD_STUB_KEY_CHURN_INTERVAL "X-Stub-Churn-Interval"
+
+#define HD_STUB_VALUE_STATUS_MENU "status-menu"
+
+#define ICON_SIZE 18
+
+#define HD_STUB_PLUGIN_MANAGER_GET_PRIVATE(object) \
+  (G_TYPE_INSTANCE_GET_PRIVATE ((object), HD_TYPE_STUB_PLUGIN_MANAGER, HDStubPluginManagerPrivate))
+
+typedef struct _HDStubPlugin HDStubPlugin;
+struct _HDStubPlugin
+{
+  HDStubPluginManager *manager;
+
+  gchar     *plugin_id;
+  gboolean   menu_item;
+  gboolean   clock;
+
+  guint      add_time;
+  guint      remove_time;
+  guint      churn_interval;
+
+  GdkPixbuf *icon;
+  guint      icon_interval;
+  gboolean   icon_shown;
+
+  GObject   *item;
+
+  guint      add_id;
+  guint      remove_id;
+  guint      icon_id;
+
+  /* The first, scheduled add is done */
+  gboolean   added;
+};
+
+struct _HDStubPluginManagerPrivate
+{
+  GKeyFile *key_file;
+
+  /* HDStubPlugin in script order */
+  GList    *plugins;
+
+  /* Plugins whose first add is still scheduled */
+  guint     n_adds_pending;
+};
+
+enum
+{
+  PLUGIN_ADDED,
+  PLUGIN_REMOVED,
+  ITEMS_CONFIGURATION_LOADED,
+  PLUGINS_LOADED,
+
+  LAST_SIGNAL
+};
+
+static guint stub_signals[LAST_SIGNAL] = { 0, };
+
+static void hd_stub_plugin_manager_dispose  (GObject *object);
+static void hd_stub_plugin_manager_finalize (GObject *object);
+
+G_DEFINE_TYPE (HDStubPluginManager, hd_stub_plugin_manager, G_TYPE_OBJECT);
+
+static void
+hd_stub_plugin_manager_class_init (HDStubPluginManagerClass *klass)
+{
+  GObjectClass *object_class = G_OBJECT_CLASS (klass);
+
+  object_class->dispose = hd_stub_plugin_manager_dispose;
+  object_class->finalize = hd_stub_plugin_manager_finalize;
+
+  /* Same signals as HDPluginManager */
+  stub_signals[PLUGIN_ADDED] = g_signal_new ("plugin-added",
+                                             HD_TYPE_STUB_PLUGIN_MANAGER,
+                                             0, 0,
+                                             NULL, NULL,
+                                             g_cclosure_marshal_VOID__OBJECT,
+                                             G_TYPE_NONE,
+                                             1, G_TYPE_OBJECT);
+  stub_signals[PLUGIN_REMOVED] = g_signal_new ("plugin-removed",
+                                               HD_TYPE_STUB_PLUGIN_MANAGER,
+                                               0, 0,
+                                               NULL, NULL,
+                                               g_cclosure_marshal_VOID__OBJECT,
+                                               G_TYPE_NONE,
+                                               1, G_TYPE_OBJECT);
+  stub_signals[ITEMS_CONFIGURATION_LOADED] = g_signal_new ("items-configuration-loaded",
+                                                           HD_TYPE_STUB_PLUGIN_MANAGER,
+                                                           0, 0,
+                                                           NULL, NULL,
+                                                           g_cclosure_marshal_VOID__POINTER,
+                                                           G_TYPE_NONE,
+                                                           1, G_TYPE_POINTER);
+  /* Not in HDPluginManager, which adds all plugins in run */
+  stub_signals[PLUGINS_LOADED] = g_signal_new ("plugins-loaded",
+                                               HD_TYPE_STUB_PLUGIN_MANAGER,
+                                               0, 0,
+                                               NULL, NULL,
+                                               g_cclosure_marshal_VOID__VOID,
+                                               G_TYPE_NONE,
+                                               0);
+
+  g_type_class_add_private (klass, sizeof (HDStubPluginManagerPrivate));
+}
+
+static void
+hd_stub_plugin_manager_init (HDStubPluginManager *manager)
+{
+  manager->priv = HD_STUB_PLUGIN_MANAGER_GET_PRIVATE (manager);
+
+  manager->priv->key_file = g_key_file_new ();
+}
+
+static void
+update_icon (HDStubPlugin *stub)
+{
+  hd_status_plugin_item_set_status_area_icon (HD_STATUS_PLUGIN_ITEM (stub->item),
+                                              stub->icon_shown ? stub->icon : NULL);
+}
+
+static gboolean
+toggle_icon_cb (gpointer data)
+{
+  HDStubPlugin *stub = data;
+
+  stub->icon_shown = !stub->icon_shown;
+  update_icon (stub);
+
+  return TRUE;
+}
+
+static void
+add_plugin (HDStubPlugin *stub)
+{
+  GtkWidget *label;
+
+  if (stub->item)
+    return;
+
+  if (stub->menu_item)
+    stub->item = g_object_new (HD_TYPE_STATUS_MENU_ITEM,
+                               "plugin-id", stub->plugin_id,
+                               NULL);
+  else
+    stub->item = g_object_new (HD_TYPE_STATUS_PLUGIN_ITEM,
+                               "plugin-id", stub->plugin_id,
+                               NULL);
+  g_object_ref_sink (stub->item);
+
+  /* Menu items show themselves */
+  label = gtk_label_new (stub->plugin_id);
+  gtk_widget_show (label);
+  gtk_container_add (GTK_CONTAINER (stub->item), label);
+  if (stub->menu_item)
+    gtk_widget_show (GTK_WIDGET (stub->item));
+
+  /* The clock provides a widget instead of an icon */
+  if (stub->clock)
+    {
+      label = gtk_label_new (stub->plugin_id);
+      gtk_widget_show (label);
+      hd_status_plugin_item_set_status_area_widget (HD_STATUS_PLUGIN_ITEM (stub->item),
+                                                    label);
+    }
+  else if (!stub->menu_item && stub->icon)
+    {
+      stub->icon_shown = TRUE;
+      update_icon (stub);
+    }
+
+  g_signal_emit (stub->manager, stub_signals[PLUGIN_ADDED], 0, stub->item);
+
+  if (!stub->menu_item && stub->icon && stub->icon_interval)
+    stub->icon_id = g_timeout_add (stub->icon_interval, toggle_icon_cb, stub);
+}
+
+static void
+remove_plugin (HDStubPlugin *stub)
+{
+  if (stub->icon_id)
+    {
+      g_source_remove (stub->icon_id);
+      stub->icon_id = 0;
+    }
+
+  if (!stub->item)
+    return;
+
+  g_signal_emit (stub->manager, stub_signals[PLUGIN_REMOVED], 0, stub->item);
+
+  gtk_widget_destroy (GTK_WIDGET (stub->item));
+  stub->item = (g_object_unref (stub->item), NULL);
+}
+
+static gboolean remove_plugin_cb (gpointer data);
+
+static gboolean
+add_plugin_cb (gpointer data)
+{
+  HDStubPlugin *stub = data;
+  HDStubPluginManagerPrivate *priv = stub->manager->priv;
+
+  stub->add_id = 0;
+  add_plugin (stub);
+
+  if (!stub->added)
+    {
+      stub->added = TRUE;
+      if (--priv->n_adds_pending == 0)
+        g_signal_emit (stub->manager, stub_signals[PLUGINS_LOADED], 0);
+    }
+
+  if (stub->churn_interval && !stub->remove_id)
+    stub->remove_id = g_timeout_add (stub->churn_interval, remove_plugin_cb, stub);
+
+  return FALSE;
+}
+
+static gboolean
+remove_plugin_cb (gpointer data)
+{
+  HDStubPlugin *stub = data;
+
+  stub->remove_id = 0;
+  remove_plugin (stub);
+
+  if (stub->churn_interval && !stub->add_id)
+    stub->add_id = g_timeout_add (stub->churn_interval, add_plugin_cb, stub);
+
+  return FALSE;
+}
+
+static void
+free_plugin (HDStubPlugin *stub)
+{
+  if (stub->add_id)
+    g_source_remove (stub->add_id);
+  if (stub->remove_id)
+    g_source_remove (stub->remove_id);
+  if (stub->icon_id)
+    g_source_remove (stub->icon_id);
+
+  if (stub->item)
+    {
+      gtk_widget_destroy (GTK_WIDGET (stub->item));
+      g_object_unref (stub->item);
+    }
+
+  if (stub->icon)
+    g_object_unref (stub->icon);
+
+  g_free (stub->plugin_id);
+  g_slice_free (HDStubPlugin, stub);
+}
+
+static void
+hd_stub_plugin_manager_dispose (GObject *object)
+{
+  HDStubPluginManagerPrivate *priv = HD_STUB_PLUGIN_MANAGER (object)->priv;
+
+  g_list_foreach (priv->plugins, (GFunc) free_plugin, NULL);
+  g_list_free (priv->plugins);
+  priv->plugins = NULL;
+
+  G_OBJECT_CLASS (hd_stub_plugin_manager_parent_class)->dispose (object);
+}
+
+static void
+hd_stub_plugin_manager_finalize (GObject *object)
+{
+  HDStubPluginManagerPrivate *priv = HD_STUB_PLUGIN_MANAGER (object)->priv;
+
+  g_key_file_free (priv->key_file);
+
+  G_OBJECT_CLASS (hd_stub_plugin_manager_parent_class)->finalize (object);
+}
+
+static guint
+get_time (GKeyFile    *key_file,
+          const gchar *group,
+          const gchar *key,
+          guint        default_value)
+{
+  GError *error = NULL;
+  gint value;
+
+  value = g_key_file_get_integer (key_file, group, key, &error);
+  if (error)
+    {
+      g_error_free (error);
+      return default_value;
+    }
+
+  return MAX (value, 0);
+}
+
+/**
+ * hd_stub_plugin_manager_new:
+ *
+ * Create a new plugin manager stand-in without plugins.
+ *
+ * Returns: a new #HDStubPluginManager.
+ **/
+HDStubPluginManager *
+hd_stub_plugin_manager_new (void)
+{
+  return g_object_new (HD_TYPE_STUB_PLUGIN_MANAGER, NULL);
+}
+
+/* Creates the plugins of the script in priv->key_file */
+static void
+load_plugins (HDStubPluginManager *manager)
+{
+  HDStubPluginManagerPrivate *priv = manager->priv;
+  gchar **groups;
+  guint i;
+
+  groups = g_key_file_get_groups (priv->key_file, NULL);
+
+  for (i = 0; groups[i]; i++)
+    {
+      HDStubPlugin *stub;
+      gchar *value;
+
+      stub = g_slice_new0 (HDStubPlugin);
+      stub->manager = manager;
+      stub->plugin_id = g_strdup (groups[i]);
+
+      value = g_key_file_get_string (priv->key_file, groups[i],
+                                     HD_STUB_KEY_TYPE, NULL);
+      stub->menu_item = value && strcmp (value, HD_STUB_VALUE_STATUS_MENU) == 0;
+      g_free (value);
+
+      value = g_key_file_get_string (priv->key_file, groups[i],
+                                     HD_STATUS_AREA_CONFIG_KEY_PERMANENT_ITEM, NULL);
+      stub->clock = value && strcmp (value, HD_STATUS_AREA_CONFIG_VALUE_CLOCK) == 0;
+      g_free (value);
+
+      stub->add_time = get_time (priv->key_file, groups[i],
+                                 HD_STUB_KEY_ADD_TIME, 0);
+      stub->remove_time = get_time (priv->key_file, groups[i],
+                                    HD_STUB_KEY_REMOVE_TIME, G_MAXUINT);
+      stub->icon_interval = get_time (priv->key_file, groups[i],
+                                      HD_STUB_KEY_ICON_INTERVAL, 0);
+      stub->churn_interval = get_time (priv->key_file, groups[i],
+                                       HD_STUB_KEY_CHURN_INTERVAL, 0);
+
+      value = g_key_file_get_string (priv->key_file, groups[i],
+                                     HD_STUB_KEY_ICON, NULL);
+      if (value)
+        {
+          stub->icon = gtk_icon_theme_load_icon (gtk_icon_theme_get_default (),
+                                                 value, ICON_SIZE,
+                                                 GTK_ICON_LOOKUP_NO_SVG, NULL);
+
+          /* Without the icon theme (e.g. on Xvfb) */
+          if (!stub->icon)
+            {
+              stub->icon = gdk_pixbuf_new (GDK_COLORSPACE_RGB, TRUE, 8,
+                                           ICON_SIZE, ICON_SIZE);
+              gdk_pixbuf_fill (stub->icon, 0x808080ff);
+            }
+        }
+      g_free (value);
+
+      priv->plugins = g_list_prepend (priv->plugins, stub);
+    }
+
+  priv->plugins = g_list_reverse (priv->plugins);
+
+  g_strfreev (groups);
+}
+
+/**
+ * hd_stub_plugin_manager_load_script:
+ * @manager: a #HDStubPluginManager
+ * @filename: the script key file
+ * @error: return location for a #GError, or %NULL
+ *
+ * Read the plugins and their configuration from @filename. See the top of
+ * hd-stub-plugin-manager.c for the format.
+ *
+ * Returns: %TRUE if the script could be read.
+ **/
+gboolean
+hd_stub_plugin_manager_load_script (HDStubPluginManager  *manager,
+                                    const gchar          *filename,
+                                    GError              **error)
+{
+  g_return_val_if_fail (HD_IS_STUB_PLUGIN_MANAGER (manager), FALSE);
+
+  if (!g_key_file_load_from_file (manager->priv->key_file, filename,
+                                  G_KEY_FILE_NONE, error))
+    return FALSE;
+
+  load_plugins (manager);
+
+  return TRUE;
+}
+
+/**
+ * hd_stub_plugin_manager_load_data:
+ * @manager: a #HDStubPluginManager
+ * @data: the script
+ * @error: return location for a #GError, or %NULL
+ *
+ * Like hd_stub_plugin_manager_load_script() for a script in memory, used
+ * by the test and benchmark programs.
+ *
+ * Returns: %TRUE if the script could be parsed.
+ **/
+gboolean
+hd_stub_plugin_manager_load_data (HDStubPluginManager  *manager,
+                                  const gchar          *data,
+                                  GError              **error)
+{
+  g_return_val_if_fail (HD_IS_STUB_PLUGIN_MANAGER (manager), FALSE);
+  g_return_val_if_fail (data != NULL, FALSE);
+
+  if (!g_key_file_load_from_data (manager->priv->key_file, data, -1,
+                                  G_KEY_FILE_NONE, error))
+    return FALSE;
+
+  load_plugins (manager);
+
+  return TRUE;
+}
+
+/**
+ * hd_stub_plugin_manager_run:
+ * @manager: a #HDStubPluginManager
+ *
+ * Emit ::items-configuration-loaded and add and remove the scripted plugins
+ * at their scheduled times. ::plugins-loaded is emitted once all plugins
+ * were added, before returning if no add is scheduled later.
+ **/
+void
+hd_stub_plugin_manager_run (HDStubPluginManager *manager)
+{
+  HDStubPluginManagerPrivate *priv;
+  GList *p;
+
+  g_return_if_fail (HD_IS_STUB_PLUGIN_MANAGER (manager));
+
+  priv = manager->priv;
+
+  g_signal_emit (manager, stub_signals[ITEMS_CONFIGURATION_LOADED], 0,
+                 priv->key_file);
+
+  for (p = priv->plugins; p; p = p->next)
+    {
+      HDStubPlugin *stub = p->data;
+
+      if (stub->add_time == 0)
+        {
+          add_plugin (stub);
+          stub->added = TRUE;
+        }
+      else
+        {
+          stub->add_id = g_timeout_add (stub->add_time, add_plugin_cb, stub);
+          priv->n_adds_pending++;
+        }
+
+      if (stub->remove_time != G_MAXUINT)
+        stub->remove_id = g_timeout_add (stub->remove_time, remove_plugin_cb, stub);
+      else if (stub->add_time == 0 && stub->churn_interval)
+        stub->remove_id = g_timeout_add (stub->churn_interval, remove_plugin_cb, stub);
+    }
+
+  if (!priv->n_adds_pending)
+    g_signal_emit (manager, stub_signals[PLUGINS_LOADED], 0);
+}
+
+/**
+ * hd_stub_plugin_manager_set_icon_shown:
+ * @manager: a #HDStubPluginManager
+ * @plugin_id: the plugin id of a Status Area plugin in the script
+ * @shown: whether the plugin shows its X-Stub-Icon
+ *
+ * Show or hide the Status Area icon of a synthetic plugin, used to replay
+ * the icon changes of traces (see hd-trace.c).
+ **/
+void
+hd_stub_plugin_manager_set_icon_shown (HDStubPluginManager *manager,
+                                       const gchar         *plugin_id,
+                                       gboolean             shown)
+{
+  GList *p;
+
+  g_return_if_fail (HD_IS_STUB_PLUGIN_MANAGER (manager));
+  g_return_if_fail (plugin_id != NULL);
+
+  for (p = manager->priv->plugins; p; p = p->next)
+    {
+      HDStubPlugin *stub = p->data;
+
+      if (strcmp (stub->plugin_id, plugin_id) != 0)
+        continue;
+
+      if (!stub->item || stub->menu_item || !stub->icon)
+        {
+          g_warning ("%s: %s is not a Status Area plugin with an icon",
+                     __FUNCTION__, plugin_id);
+          return;
+        }
+
+      stub->icon_shown = shown;
+      update_icon (stub);
+      return;
+    }
+
+  g_warning ("%s: unknown plugin %s", __FUNCTION__, plugin_id);
+}
+
+/**
+ * hd_stub_plugin_manager_add_plugins:
+ * @manager: a #HDStubPluginManager
+ *
+ * Add all plugins of the script which are not added, now. Used to drive
+ * add and remove cycles.
+ **/
+void
+hd_stub_plugin_manager_add_plugins (HDStubPluginManager *manager)
+{
+  g_return_if_fail (HD_IS_STUB_PLUGIN_MANAGER (manager));
+
+  g_list_foreach (manager->priv->plugins, (GFunc) add_plugin, NULL);
+}
+
+/**
+ * hd_stub_plugin_manager_remove_plugins:
+ * @manager: a #HDStubPluginManager
+ *
+ * Remove all plugins of the script which are added, now.
+ **/
+void
+hd_stub_plugin_manager_remove_plugins (HDStubPluginManager *manager)
+{
+  g_return_if_fail (HD_IS_STUB_PLUGIN_MANAGER (manager));
+
+  g_list_foreach (manager->priv->plugins, (GFunc) remove_plugin, NULL);
+}
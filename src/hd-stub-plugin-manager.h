@@ -0,0 +1,80 @@
+/*
+ * This file is part of hildon-status-menu
+ * 
+ * Copyright (C) 2010 Nokia Corporation.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * version 2.1 as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ */
+
+#ifndef __HD_STUB_PLUGIN_MANAGER_H__
+#define __HD_STUB_PLUGIN_MANAGER_H__
+
+#include <glib-object.h>
+
+G_BEGIN_DECLS
+
+#define HD_TYPE_STUB_PLUGIN_MANAGER            (hd_stub_plugin_manager_get_type ())
+#define HD_STUB_PLUGIN_MANAGER(obj)            (G_TYPE_CHECK_INSTANCE_CAST ((obj), HD_TYPE_STUB_PLUGIN_MANAGER, HDStubPluginManager))
+#define HD_STUB_PLUGIN_MANAGER_CLASS(klass)    (G_TYPE_CHECK_CLASS_CAST ((klass), HD_TYPE_STUB_PLUGIN_MANAGER, HDStubPluginManagerClass))
+#define HD_IS_STUB_PLUGIN_MANAGER(obj)         (G_TYPE_CHECK_INSTANCE_TYPE ((obj), HD_TYPE_STUB_PLUGIN_MANAGER))
+#define HD_IS_STUB_PLUGIN_MANAGER_CLASS(klass) (G_TYPE_CHECK_CLASS_TYPE ((klass), HD_TYPE_STUB_PLUGIN_MANAGER))
+#define HD_STUB_PLUGIN_MANAGER_GET_CLASS(obj)  (G_TYPE_INSTANCE_GET_CLASS ((obj), HD_TYPE_STUB_PLUGIN_MANAGER, HDStubPluginManagerClass))
+
+/** HDStubPluginManager:
+ *
+ * An in-memory stand-in for #HDPluginManager. It emits ::plugin-added,
+ * ::plugin-removed and ::items-configuration-loaded for synthetic status
+ * plugins described in a script key file, so #HDStatusArea and
+ * #HDStatusMenu can be run without plugin .desktop files and libraries.
+ **/
+typedef struct _HDStubPluginManager        HDStubPluginManager;
+typedef struct _HDStubPluginManagerClass   HDStubPluginManagerClass;
+typedef struct _HDStubPluginManagerPrivate HDStubPluginManagerPrivate;
+
+struct _HDStubPluginManager
+{
+  GObject parent;
+
+  HDStubPluginManagerPrivate *priv;
+};
+
+struct _HDStubPluginManagerClass
+{
+  GObjectClass parent;
+};
+
+GType                hd_stub_plugin_manager_get_type    (void);
+
+HDStubPluginManager *hd_stub_plugin_manager_new         (void);
+
+gboolean             hd_stub_plugin_manager_load_script (HDStubPluginManager  *manager,
+                                                         const gchar          *filename,
+                                                         GError              **error);
+gboolean             hd_stub_plugin_manager_load_data   (HDStubPluginManager  *manager,
+                                                         const gchar          *data,
+                                                         GError              **error);
+void                 hd_stub_plugin_manager_run         (HDStubPluginManager  *manager);
+
+void                 hd_stub_plugin_manager_add_plugins    (HDStubPluginManager *manager);
+void                 hd_stub_plugin_manager_remove_plugins (HDStubPluginManager *manager);
+
+void                 hd_stub_plugin_manager_set_icon_shown (HDStubPluginManager *manager,
+                                                            const gchar         *plugin_id,
+                                                            gboolean             shown);
+
+G_END_DECLS
+
+#endif
@@ -0,0 +1,253 @@
+/*
+ * This file is part of hildon-status-menu
+ * 
+ * Copyright (C) 2010 Nokia Corporation.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * version 2.1 as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <libhildondesktop/libhildondesktop.h>
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "hd-metrics.h"
+#include "hd-stub-plugin-manager.h"
+#include "hd-trace.h"
+
+/* Recording and replay of the inputs of the Status Area and Menu.
+ *
+ * With HD_STATUS_MENU_TRACE set to a file name, the inputs are appended to
+ * that file, one "<ms> <event> <argument>" line each, the time in
+ * milliseconds since startup:
+ *
+ *   <ms> current-app-window <window>    _MB_CURRENT_APP_WINDOW changes
+ *   <ms> mce-display <on|dim|off>       MCE display status signals
+ *   <ms> dsme <signal>                  DSME signals
+ *   <ms> icon <plugin id> <0|1>         Status Area icon set or unset
+ *
+ * Traces are replayed with replay-trace, which runs the process on a
+ * Xvfb and a bus of its own and changes the root window property and
+ * sends the signals at their times, so they go through the same code
+ * as live input and nothing else reaches the process. It sets
+ * HD_STATUS_MENU_REPLAY to the trace, the icon changes are then replayed
+ * here on the plugin manager stand-in (see HD_STATUS_MENU_PLUGIN_SCRIPT),
+ * the plugins in the trace need a X-Stub-Icon in the script. The other
+ * events are left to replay-trace.
+ */
+
+typedef struct _HDTraceEvent HDTraceEvent;
+struct _HDTraceEvent
+{
+  guint  time;
+  gchar *event;
+  gchar *arg;
+};
+
+static guint64    start_time = 0;
+
+static FILE      *trace_file = NULL;
+
+static GQueue    *replay_events = NULL;
+static GObject   *replay_plugin_manager = NULL;
+
+static guint
+get_elapsed (void)
+{
+  return (hd_metrics_get_time () - start_time) / 1000;
+}
+
+void
+hd_trace_record (const gchar *event,
+                 const gchar *format,
+                 ...)
+{
+  va_list args;
+
+  if (!trace_file)
+    return;
+
+  fprintf (trace_file, "%u %s ", get_elapsed (), event);
+
+  va_start (args, format);
+  vfprintf (trace_file, format, args);
+  va_end (args);
+
+  fputc ('\n', trace_file);
+
+  /* Keep the trace up to the last event when the process dies */
+  fflush (trace_file);
+}
+
+void
+hd_trace_record_icon (GObject  *plugin,
+                      gboolean  shown)
+{
+  gchar *plugin_id;
+
+  if (!trace_file || !HD_IS_PLUGIN_ITEM (plugin))
+    return;
+
+  plugin_id = hd_plugin_item_get_plugin_id (HD_PLUGIN_ITEM (plugin));
+  hd_trace_record (HD_TRACE_ICON, "%s %d", plugin_id, shown ? 1 : 0);
+  g_free (plugin_id);
+}
+
+/* Only icon changes are loaded, see load_replay */
+static void
+replay_event (HDTraceEvent *event)
+{
+  gchar *shown;
+
+  shown = strrchr (event->arg, ' ');
+  if (!shown || !HD_IS_STUB_PLUGIN_MANAGER (replay_plugin_manager))
+    {
+      g_warning ("%s: cannot replay icon change %s",
+                 __FUNCTION__, event->arg);
+      return;
+    }
+
+  *shown = '\0';
+  hd_stub_plugin_manager_set_icon_shown (HD_STUB_PLUGIN_MANAGER (replay_plugin_manager),
+                                         event->arg,
+                                         atoi (shown + 1));
+}
+
+static void
+free_event (HDTraceEvent *event)
+{
+  g_free (event->event);
+  g_free (event->arg);
+  g_slice_free (HDTraceEvent, event);
+}
+
+static gboolean replay_cb (gpointer data);
+
+static void
+schedule_replay (void)
+{
+  HDTraceEvent *event = g_queue_peek_head (replay_events);
+  guint elapsed;
+
+  if (!event)
+    return;
+
+  elapsed = get_elapsed ();
+  g_timeout_add (event->time > elapsed ? event->time - elapsed : 0,
+                 replay_cb, NULL);
+}
+
+static gboolean
+replay_cb (gpointer data)
+{
+  HDTraceEvent *event;
+  guint elapsed = get_elapsed ();
+
+  while ((event = g_queue_peek_head (replay_events)) &&
+         event->time <= elapsed)
+    {
+      g_queue_pop_head (replay_events);
+
+      replay_event (event);
+      free_event (event);
+    }
+
+  schedule_replay ();
+
+  return FALSE;
+}
+
+static gboolean
+load_replay (const gchar *filename)
+{
+  gchar *contents;
+  gchar **lines;
+  GError *error = NULL;
+  guint i;
+
+  if (!g_file_get_contents (filename, &contents, NULL, &error))
+    {
+      g_warning ("%s: could not load trace %s. %s",
+                 __FUNCTION__, filename, error->message);
+      g_error_free (error);
+      return FALSE;
+    }
+
+  replay_events = g_queue_new ();
+
+  lines = g_strsplit (contents, "\n", -1);
+  for (i = 0; lines[i]; i++)
+    {
+      gchar **fields;
+
+      if (!*lines[i])
+        continue;
+
+      fields = g_strsplit (lines[i], " ", 3);
+      if (g_strv_length (fields) != 3)
+        g_warning ("%s: invalid line %u in trace %s",
+                   __FUNCTION__, i + 1, filename);
+      /* The X and bus events are replayed by replay-trace */
+      else if (!strcmp (fields[1], HD_TRACE_ICON))
+        {
+          HDTraceEvent *event = g_slice_new (HDTraceEvent);
+
+          event->time = strtoul (fields[0], NULL, 10);
+          event->event = g_strdup (fields[1]);
+          event->arg = g_strdup (fields[2]);
+
+          g_queue_push_tail (replay_events, event);
+        }
+
+      g_strfreev (fields);
+    }
+
+  g_strfreev (lines);
+  g_free (contents);
+
+  return TRUE;
+}
+
+void
+hd_trace_init (GObject *plugin_manager)
+{
+  const gchar *filename;
+
+  start_time = hd_metrics_get_time ();
+
+  filename = getenv ("HD_STATUS_MENU_TRACE");
+  if (filename && !trace_file)
+    {
+      trace_file = fopen (filename, "w");
+      if (!trace_file)
+        g_warning ("%s: failed to open %s", __FUNCTION__, filename);
+    }
+
+  filename = getenv ("HD_STATUS_MENU_REPLAY");
+  if (filename && !replay_events && load_replay (filename))
+    {
+      /* Kept for the lifetime of the process */
+      replay_plugin_manager = g_object_ref (plugin_manager);
+
+      schedule_replay ();
+    }
+}
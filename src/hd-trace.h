@@ -0,0 +1,45 @@
+/*
+ * This file is part of hildon-status-menu
+ * 
+ * Copyright (C) 2010 Nokia Corporation.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * version 2.1 as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ */
+
+#ifndef __HD_TRACE_H__
+#define __HD_TRACE_H__
+
+#include <glib-object.h>
+
+G_BEGIN_DECLS
+
+/* Traced inputs */
+#define HD_TRACE_CURRENT_APP_WINDOW "current-app-window"
+#define HD_TRACE_MCE_DISPLAY        "mce-display"
+#define HD_TRACE_DSME               "dsme"
+#define HD_TRACE_ICON               "icon"
+
+void hd_trace_init        (GObject     *plugin_manager);
+
+void hd_trace_record      (const gchar *event,
+                           const gchar *format,
+                           ...) G_GNUC_PRINTF (2, 3);
+void hd_trace_record_icon (GObject     *plugin,
+                           gboolean     shown);
+
+G_END_DECLS
+
+#endif
@@ -0,0 +1,375 @@
+/*
+ * This file is part of hildon-status-menu
+ * 
+ * Copyright (C) 2010 Nokia Corporation.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * version 2.1 as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+/* dladdr */
+#define _GNU_SOURCE
+
+#include <glib.h>
+#include <gdk/gdkx.h>
+#include <dbus/dbus.h>
+
+#include <dlfcn.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "hd-metrics.h"
+#include "hd-wakeups.h"
+
+/* Optional main loop wakeup accounting, enabled by setting the
+ * environment variable HD_STATUS_MENU_WAKEUPS to the interval of the
+ * summaries in seconds. Every time the main loop wakes up from a sleep
+ * the ready file descriptors are attributed to their sources, or the
+ * wakeup to a timeout if none is ready. In addition each dispatched
+ * timeout and idle source is attributed to the library (plugin, GTK+,
+ * ...) or program containing its callback, so the timeouts and idles
+ * of each plugin show up. The sources added with gdk_threads_add_idle
+ * and gdk_threads_add_timeout are attributed to the callback they wrap,
+ * not to GDK. One summary line of wakeups and dispatches
+ * per second is appended to the file each interval, the summary itself
+ * is one timeout of hildon-status-menu. */
+#define HD_WAKEUPS_DIR  "/tmp/hildon-desktop/"
+#define HD_WAKEUPS_FILE HD_WAKEUPS_DIR "status-menu.wakeups"
+
+#define MAX_FDS 8
+
+typedef struct _HDWakeupsFd HDWakeupsFd;
+struct _HDWakeupsFd
+{
+  gint         fd;
+  const gchar *name;
+  guint        count;
+};
+
+/* Dispatches of the timeout and idle sources of a library */
+typedef struct _HDWakeupsSource HDWakeupsSource;
+struct _HDWakeupsSource
+{
+  guint timeouts;
+  guint idles;
+};
+
+static GPollFunc   poll_func = NULL;
+
+/* The dispatch functions of the GLib timeout and idle sources */
+static gboolean  (*timeout_dispatch) (GSource     *source,
+                                      GSourceFunc  callback,
+                                      gpointer     user_data) = NULL;
+static gboolean  (*idle_dispatch)    (GSource     *source,
+                                      GSourceFunc  callback,
+                                      gpointer     user_data) = NULL;
+
+/* HDWakeupsSource by library name */
+static GHashTable *sources = NULL;
+
+/* The data of the sources of gdk_threads_add_idle_full and
+ * gdk_threads_add_timeout_full, as in gdk.c of GTK+ 2 */
+typedef struct _HDWakeupsGdkDispatch HDWakeupsGdkDispatch;
+struct _HDWakeupsGdkDispatch
+{
+  GSourceFunc    func;
+  gpointer       data;
+  GDestroyNotify destroy;
+};
+
+/* The (static) callback of those sources, found with an idle added in
+ * hd_wakeups_init */
+static guint       gdk_probe_id = 0;
+static GSourceFunc gdk_dispatch = NULL;
+
+static HDWakeupsFd fds[MAX_FDS];
+static guint       n_fds = 0;
+
+static guint       wakeups = 0;
+static guint       timeouts = 0;
+static guint       others = 0;
+
+static guint64     last_summary = 0;
+
+static gint
+wakeups_poll (GPollFD *ufds,
+              guint    nfds,
+              gint     timeout)
+{
+  gboolean other = FALSE;
+  gint ready;
+  guint i, j;
+
+  ready = poll_func (ufds, nfds, timeout);
+
+  /* Only count the iterations which could have slept */
+  if (timeout == 0)
+    return ready;
+
+  wakeups++;
+
+  if (ready == 0)
+    {
+      timeouts++;
+      return ready;
+    }
+
+  for (i = 0; i < nfds; i++)
+    {
+      if (!ufds[i].revents)
+        continue;
+
+      for (j = 0; j < n_fds; j++)
+        if (fds[j].fd == ufds[i].fd)
+          break;
+
+      if (j < n_fds)
+        fds[j].count++;
+      else
+        other = TRUE;
+    }
+
+  /* Interrupted by a signal or woken by an unknown source */
+  if (ready < 0 || other)
+    others++;
+
+  return ready;
+}
+
+static HDWakeupsSource *
+lookup_source (GSourceFunc callback)
+{
+  HDWakeupsSource *source;
+  const gchar *name = "unknown";
+  Dl_info info;
+
+  if (callback && dladdr ((gpointer) callback, &info) && info.dli_fname)
+    {
+      const gchar *base = strrchr (info.dli_fname, '/');
+
+      name = base ? base + 1 : info.dli_fname;
+    }
+
+  source = g_hash_table_lookup (sources, name);
+  if (!source)
+    {
+      source = g_new0 (HDWakeupsSource, 1);
+      g_hash_table_insert (sources, g_strdup (name), source);
+    }
+
+  return source;
+}
+
+/* The function called by callback with user_data */
+static GSourceFunc
+unwrap_callback (GSource     *source,
+                 GSourceFunc  callback,
+                 gpointer     user_data)
+{
+  if (G_UNLIKELY (!gdk_dispatch) && gdk_probe_id &&
+      g_source_get_id (source) == gdk_probe_id)
+    {
+      gdk_dispatch = callback;
+      gdk_probe_id = 0;
+      return NULL;
+    }
+
+  if (callback && callback == gdk_dispatch && user_data)
+    return ((HDWakeupsGdkDispatch *) user_data)->func;
+
+  return callback;
+}
+
+static gboolean
+wakeups_timeout_dispatch (GSource     *source,
+                          GSourceFunc  callback,
+                          gpointer     user_data)
+{
+  /* Sources of other threads' main contexts are not accounted */
+  if (g_main_context_is_owner (NULL))
+    lookup_source (unwrap_callback (source, callback, user_data))->timeouts++;
+
+  return timeout_dispatch (source, callback, user_data);
+}
+
+static gboolean
+wakeups_idle_dispatch (GSource     *source,
+                       GSourceFunc  callback,
+                       gpointer     user_data)
+{
+  GSourceFunc func;
+
+  if (g_main_context_is_owner (NULL))
+    {
+      func = unwrap_callback (source, callback, user_data);
+
+      /* Not the probe itself */
+      if (func)
+        lookup_source (func)->idles++;
+    }
+
+  return idle_dispatch (source, callback, user_data);
+}
+
+static gboolean
+gdk_probe_cb (gpointer data)
+{
+  return FALSE;
+}
+
+typedef struct _HDWakeupsSummary HDWakeupsSummary;
+struct _HDWakeupsSummary
+{
+  FILE    *file;
+  gdouble  elapsed;
+};
+
+static void
+write_source (const gchar      *name,
+              HDWakeupsSource  *source,
+              HDWakeupsSummary *summary)
+{
+  if (source->timeouts)
+    fprintf (summary->file, " timeout:%s %.2f",
+             name, source->timeouts / summary->elapsed);
+  if (source->idles)
+    fprintf (summary->file, " idle:%s %.2f",
+             name, source->idles / summary->elapsed);
+}
+
+static gboolean
+summary_cb (gpointer data)
+{
+  guint64 now;
+  gdouble elapsed;
+  FILE *file;
+  HDWakeupsSummary summary;
+  guint i;
+
+  now = hd_metrics_get_time ();
+  elapsed = (now - last_summary) / (gdouble) G_USEC_PER_SEC;
+  last_summary = now;
+
+  if (elapsed <= 0)
+    return TRUE;
+
+  g_mkdir_with_parents (HD_WAKEUPS_DIR, 0755);
+
+  file = fopen (HD_WAKEUPS_FILE, "a");
+  if (file)
+    {
+      fprintf (file, "%" G_GUINT64_FORMAT " wakeups/s %.2f",
+               now / G_USEC_PER_SEC, wakeups / elapsed);
+
+      for (i = 0; i < n_fds; i++)
+        fprintf (file, " %s %.2f", fds[i].name, fds[i].count / elapsed);
+
+      fprintf (file, " timeout %.2f other %.2f",
+               timeouts / elapsed, others / elapsed);
+
+      summary.file = file;
+      summary.elapsed = elapsed;
+      g_hash_table_foreach (sources, (GHFunc) write_source, &summary);
+
+      fprintf (file, "\n");
+
+      fclose (file);
+    }
+  else
+    g_warning ("%s: failed to open %s", __FUNCTION__, HD_WAKEUPS_FILE);
+
+  wakeups = timeouts = others = 0;
+  for (i = 0; i < n_fds; i++)
+    fds[i].count = 0;
+  g_hash_table_remove_all (sources);
+
+  return TRUE;
+}
+
+void
+hd_wakeups_init (void)
+{
+  const gchar *interval;
+  DBusConnection *session_bus;
+  gint fd;
+
+  interval = getenv ("HD_STATUS_MENU_WAKEUPS");
+  if (!interval || poll_func)
+    return;
+
+  /* X events, handled by GDK and the HDDesktop root window filter */
+  hd_wakeups_add_fd (ConnectionNumber (GDK_DISPLAY_XDISPLAY (gdk_display_get_default ())),
+                     "x11");
+
+  /* GConf notifications */
+  session_bus = dbus_bus_get (DBUS_BUS_SESSION, NULL);
+  if (session_bus)
+    {
+      if (dbus_connection_get_unix_fd (session_bus, &fd))
+        hd_wakeups_add_fd (fd, "session-bus");
+      dbus_connection_unref (session_bus);
+    }
+
+  poll_func = g_main_context_get_poll_func (NULL);
+  g_main_context_set_poll_func (NULL, wakeups_poll);
+
+  /* The sources keep a pointer to these functions, so existing
+   * timeouts and idles are attributed too */
+  sources = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, g_free);
+
+  timeout_dispatch = g_timeout_funcs.dispatch;
+  g_timeout_funcs.dispatch = wakeups_timeout_dispatch;
+
+  idle_dispatch = g_idle_funcs.dispatch;
+  g_idle_funcs.dispatch = wakeups_idle_dispatch;
+
+  /* Its dispatch tells the callback of the GDK thread sources */
+  gdk_probe_id = gdk_threads_add_idle_full (G_PRIORITY_HIGH, gdk_probe_cb,
+                                            NULL, NULL);
+
+  last_summary = hd_metrics_get_time ();
+  g_timeout_add_seconds (MAX (atoi (interval), 1), summary_cb, NULL);
+}
+
+/* Attribute wakeups by fd to name, which must be a static string */
+void
+hd_wakeups_add_fd (gint         fd,
+                   const gchar *name)
+{
+  guint i;
+
+  for (i = 0; i < n_fds; i++)
+    if (fds[i].fd == fd)
+      {
+        fds[i].name = name;
+        return;
+      }
+
+  if (n_fds == MAX_FDS)
+    {
+      g_warning ("%s: too many file descriptors", __FUNCTION__);
+      return;
+    }
+
+  fds[n_fds].fd = fd;
+  fds[n_fds].name = name;
+  fds[n_fds].count = 0;
+  n_fds++;
+}
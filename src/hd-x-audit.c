@@ -0,0 +1,305 @@
+/*
+ * This file is part of hildon-status-menu
+ * 
+ * Copyright (C) 2010 Nokia Corporation.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * version 2.1 as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+/* RTLD_NEXT */
+#define _GNU_SOURCE
+
+#include <glib.h>
+#include <glib/gstdio.h>
+#include <gdk/gdkx.h>
+#include <X11/Xlibint.h>
+
+#include <dlfcn.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "hd-metrics.h"
+#include "hd-x-audit.h"
+
+/* Debug mode accounting synchronous X round-trips, enabled by setting
+ * the environment variable HD_STATUS_MENU_X_AUDIT.
+ *
+ * Every request waiting for a reply goes through _XReply in libX11, also
+ * the hidden ones: XSync in gdk_flush and gdk_error_trap_pop, atom
+ * interning, XGetWindowProperty in gdk_property_get... _XReply is wrapped
+ * below, the definition in the program takes precedence over the one of
+ * libX11 for the calls from within libX11 too. If it does not (checked
+ * with a XSync in hd_x_audit_init, e.g. when the program is a
+ * maemo-launcher module loaded after libX11), only the call sites below
+ * are seen.
+ *
+ * Operations are bracketed by hd_x_audit_begin/end and may nest, the X
+ * requests and round-trips are accounted to the innermost operation. Call
+ * sites doing blocking requests take a mark with hd_x_audit_mark before
+ * and report with hd_x_audit_round_trips after, the round-trips in
+ * between are also accounted to the call site. Without the wrapper a
+ * call site only knows that the server answered a request issued after
+ * the mark (LastKnownRequestProcessed), that is counted as one
+ * round-trip. On SIGUSR1 the totals are written to HD_X_AUDIT_FILE, one
+ * "name value" pair per line. */
+#define HD_X_AUDIT_DIR  "/tmp/hildon-desktop/"
+#define HD_X_AUDIT_FILE HD_X_AUDIT_DIR "status-menu.x-audit"
+
+#define MAX_DEPTH 8
+
+typedef struct _HDXAuditRecord HDXAuditRecord;
+struct _HDXAuditRecord
+{
+  guint       count;
+  gulong      requests;
+  gulong      round_trips;
+
+  /* Round-trips by call site, and the sum of them */
+  GHashTable *call_sites;
+  gulong      call_site_round_trips;
+};
+
+typedef struct _HDXAuditFrame HDXAuditFrame;
+struct _HDXAuditFrame
+{
+  HDXAuditOperation operation;
+  gulong            start;
+};
+
+static const gchar *operation_names[HD_X_AUDIT_N_OPERATIONS] =
+{
+  "other",
+  "startup",
+  "icon-update",
+  "visibility",
+  "menu-open",
+  "rotation"
+};
+
+static Display        *xdisplay = NULL;
+
+static HDXAuditRecord  records[HD_X_AUDIT_N_OPERATIONS];
+
+static HDXAuditFrame   stack[MAX_DEPTH];
+static guint           depth = 0;
+
+/* Replies waited for, counted by the _XReply wrapper */
+static gboolean        wrapped = FALSE;
+static gulong          n_replies = 0;
+
+static HDXAuditRecord *
+get_innermost_record (void)
+{
+  if (depth == 0)
+    return &records[HD_X_AUDIT_OTHER];
+
+  return &records[stack[MIN (depth, MAX_DEPTH) - 1].operation];
+}
+
+Status
+_XReply (Display *dpy,
+         xReply  *rep,
+         int      extra,
+         Bool     discard)
+{
+  static Status (*real_reply) (Display *, xReply *, int, Bool) = NULL;
+
+  if (G_UNLIKELY (!real_reply))
+    real_reply = (Status (*) (Display *, xReply *, int, Bool)) dlsym (RTLD_NEXT, "_XReply");
+
+  if (dpy == xdisplay)
+    {
+      n_replies++;
+      get_innermost_record ()->round_trips++;
+    }
+
+  return real_reply (dpy, rep, extra, discard);
+}
+
+void
+hd_x_audit_init (void)
+{
+  guint i;
+
+  if (xdisplay || !getenv ("HD_STATUS_MENU_X_AUDIT"))
+    return;
+
+  xdisplay = GDK_DISPLAY_XDISPLAY (gdk_display_get_default ());
+
+  for (i = 0; i < HD_X_AUDIT_N_OPERATIONS; i++)
+    records[i].call_sites = g_hash_table_new (g_str_hash, g_str_equal);
+
+  /* XSync waits for a reply */
+  XSync (xdisplay, False);
+  wrapped = n_replies > 0;
+  if (!wrapped)
+    g_warning ("%s: _XReply is not wrapped, only the marked call sites are seen",
+               __FUNCTION__);
+
+  hd_metrics_add_signal_handler (SIGUSR1, hd_x_audit_dump);
+}
+
+void
+hd_x_audit_begin (HDXAuditOperation operation)
+{
+  gulong next;
+
+  if (!xdisplay)
+    return;
+
+  g_return_if_fail (operation < HD_X_AUDIT_N_OPERATIONS);
+
+  next = NextRequest (xdisplay);
+
+  /* The requests so far are the outer operation's, operations nested
+   * deeper than MAX_DEPTH are accounted to the one at MAX_DEPTH */
+  if (depth > 0 && depth < MAX_DEPTH)
+    records[stack[depth - 1].operation].requests += next - stack[depth - 1].start;
+
+  if (depth < MAX_DEPTH)
+    {
+      stack[depth].operation = operation;
+      stack[depth].start = next;
+    }
+
+  depth++;
+}
+
+void
+hd_x_audit_end (void)
+{
+  HDXAuditRecord *record;
+  gulong next;
+
+  if (!xdisplay)
+    return;
+
+  g_return_if_fail (depth > 0);
+
+  depth--;
+
+  if (depth >= MAX_DEPTH)
+    return;
+
+  next = NextRequest (xdisplay);
+
+  record = &records[stack[depth].operation];
+  record->count++;
+  record->requests += next - stack[depth].start;
+
+  /* The outer operation continues */
+  if (depth > 0)
+    stack[depth - 1].start = next;
+}
+
+/* Returns the mark to pass to hd_x_audit_round_trips */
+gulong
+hd_x_audit_mark (void)
+{
+  if (!xdisplay)
+    return 0;
+
+  if (wrapped)
+    return n_replies;
+
+  return NextRequest (xdisplay);
+}
+
+/* call_site must be a static string */
+void
+hd_x_audit_round_trips (const gchar *call_site,
+                        gulong       mark)
+{
+  HDXAuditRecord *record;
+  gulong round_trips;
+  gsize count;
+
+  if (!xdisplay)
+    return;
+
+  if (wrapped)
+    round_trips = n_replies - mark;
+  else
+    /* The server answered a request issued since the mark. Sequence
+     * numbers wrap, only the low 32 bits are compared */
+    round_trips = (gint32) (guint32) (LastKnownRequestProcessed (xdisplay) - mark) >= 0;
+
+  if (!round_trips)
+    return;
+
+  record = get_innermost_record ();
+
+  /* The wrapper already counted them for the operation */
+  if (!wrapped)
+    record->round_trips += round_trips;
+  record->call_site_round_trips += round_trips;
+
+  count = GPOINTER_TO_SIZE (g_hash_table_lookup (record->call_sites, call_site));
+  g_hash_table_insert (record->call_sites, (gpointer) call_site,
+                       GSIZE_TO_POINTER (count + round_trips));
+}
+
+static void
+dump_call_site (const gchar *call_site,
+                gpointer     round_trips,
+                gpointer     data)
+{
+  gpointer *args = data;
+
+  fprintf (args[0], "%s.site.%s %" G_GSIZE_FORMAT "\n",
+           (const gchar *) args[1], call_site, GPOINTER_TO_SIZE (round_trips));
+}
+
+void
+hd_x_audit_dump (void)
+{
+  FILE *file;
+  guint i;
+
+  g_mkdir_with_parents (HD_X_AUDIT_DIR, 0755);
+
+  file = fopen (HD_X_AUDIT_FILE ".tmp", "w");
+  if (!file)
+    {
+      g_warning ("%s: failed to open %s", __FUNCTION__, HD_X_AUDIT_FILE ".tmp");
+      return;
+    }
+
+  for (i = 0; i < HD_X_AUDIT_N_OPERATIONS; i++)
+    {
+      gpointer args[2] = { file, (gpointer) operation_names[i] };
+
+      fprintf (file, "%s.count %u\n", operation_names[i], records[i].count);
+      fprintf (file, "%s.requests %lu\n", operation_names[i], records[i].requests);
+      fprintf (file, "%s.round-trips %lu\n", operation_names[i], records[i].round_trips);
+
+      g_hash_table_foreach (records[i].call_sites, (GHFunc) dump_call_site, args);
+
+      /* Hidden round-trips outside of the marked call sites */
+      if (wrapped && records[i].round_trips > records[i].call_site_round_trips)
+        fprintf (file, "%s.site.unmarked %lu\n", operation_names[i],
+                 records[i].round_trips - records[i].call_site_round_trips);
+    }
+
+  fclose (file);
+
+  g_rename (HD_X_AUDIT_FILE ".tmp", HD_X_AUDIT_FILE);
+}
@@ -0,0 +1,55 @@
+/*
+ * This file is part of hildon-status-menu
+ * 
+ * Copyright (C) 2010 Nokia Corporation.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * version 2.1 as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ */
+
+#ifndef __HD_X_AUDIT_H__
+#define __HD_X_AUDIT_H__
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/* High-level operations X requests and round-trips are accounted to */
+typedef enum
+{
+  HD_X_AUDIT_OTHER,
+  HD_X_AUDIT_STARTUP,
+  HD_X_AUDIT_ICON_UPDATE,
+  HD_X_AUDIT_VISIBILITY,
+  HD_X_AUDIT_MENU_OPEN,
+  HD_X_AUDIT_ROTATION,
+
+  HD_X_AUDIT_N_OPERATIONS
+} HDXAuditOperation;
+
+void   hd_x_audit_init        (void);
+
+void   hd_x_audit_begin       (HDXAuditOperation  operation);
+void   hd_x_audit_end         (void);
+
+gulong hd_x_audit_mark        (void);
+void   hd_x_audit_round_trips (const gchar       *call_site,
+                               gulong             mark);
+
+void   hd_x_audit_dump        (void);
+
+G_END_DECLS
+
+#endif
@@ -37,9 +37,22 @@
 #include <sys/stat.h>
 #include <fcntl.h>
 
+#include "hd-load-order.h"
+#include "hd-metrics.h"
+#include "hd-plugin-index.h"
+#include "hd-plugin-ready.h"
+#include "hd-preload.h"
+#include "hd-probes.h"
+#include "hd-readahead.h"
+#include "hd-ready.h"
+#include "hd-recorder.h"
 #include "hd-status-area.h"
 #include "hd-status-menu.h"
 #include "hd-status-menu-config.h"
+#include "hd-stub-plugin-manager.h"
+#include "hd-trace.h"
+#include "hd-wakeups.h"
+#include "hd-x-audit.h"
 
 #define HD_STAMP_DIR   "/tmp/hildon-desktop/"
 #define HD_STATUS_MENU_STAMP_FILE HD_STAMP_DIR "status-menu.stamp"
@@ -68,6 +81,12 @@ load_priority_func (const gchar *plugin_id,
                           NULL))
     return 0;
 
+  /* Then the plugins measured in previous runs, the cheap ones which
+   * show an icon first */
+  priority = hd_load_order_get_priority (plugin_id);
+  if (priority != G_MAXUINT)
+    return priority;
+
   /* Then the plugins should be loaded regarding to there
    * position in the status area. */
   priority = (guint) g_key_file_get_integer (keyfile,
@@ -75,7 +94,8 @@ load_priority_func (const gchar *plugin_id,
                                              HD_STATUS_AREA_CONFIG_KEY_POSITION,
                                              &error);
   if (error == NULL)
-    return priority;
+    return HD_LOAD_ORDER_UNKNOWN_PRIORITY +
+           MIN (priority, G_MAXUINT - 1 - HD_LOAD_ORDER_UNKNOWN_PRIORITY);
 
   /* If position is not set, load last (priority == max) */
   g_error_free (error);
@@ -83,16 +103,154 @@ load_priority_func (const gchar *plugin_id,
   return G_MAXUINT;
 }
 
+/* Start of the plugin-added or plugin-removed emission */
+static guint64 plugin_change_start = 0;
+
+/* Everything done since the last plugin was added (or the load started)
+ * is the construction of this plugin */
+static void
+plugin_added_cb (GObject *plugin_manager,
+                 GObject *plugin)
+{
+  plugin_change_start = hd_metrics_get_time ();
+  hd_metrics_counter_add (HD_METRICS_PLUGINS_ADDED, 1);
+
+  hd_recorder_record_plugin (HD_RECORDER_PLUGIN_ADDED, plugin);
+  HD_PROBE1 (plugin_added, plugin);
+
+  hd_metrics_plugin_loaded (plugin);
+  hd_load_order_plugin_added (plugin);
+}
+
+static void
+plugin_added_after_cb (GObject *plugin_manager,
+                       GObject *plugin)
+{
+  /* Don't account the handlers of the Status Area and Menu */
+  hd_metrics_plugin_load_resume ();
+  hd_load_order_load_resume ();
+
+  hd_metrics_add_latency (HD_METRICS_PLUGIN_ADD,
+                          hd_metrics_get_time () - plugin_change_start);
+}
+
+static void
+plugin_removed_cb (GObject *plugin_manager,
+                   GObject *plugin)
+{
+  plugin_change_start = hd_metrics_get_time ();
+  hd_metrics_counter_add (HD_METRICS_PLUGINS_REMOVED, 1);
+
+  hd_recorder_record_plugin (HD_RECORDER_PLUGIN_REMOVED, plugin);
+  HD_PROBE1 (plugin_removed, plugin);
+
+  hd_metrics_plugin_removed (plugin);
+}
+
+static void
+plugin_removed_after_cb (GObject *plugin_manager,
+                         GObject *plugin)
+{
+  hd_metrics_add_latency (HD_METRICS_PLUGIN_REMOVE,
+                          hd_metrics_get_time () - plugin_change_start);
+}
+
+static void
+items_configuration_loaded_cb (GObject  *plugin_manager,
+                               GKeyFile *key_file)
+{
+  /* Arms the deadlines of the plugins not ready yet */
+  hd_plugin_ready_set_configuration (key_file);
+}
+
+/* Set once the plugin manager added the plugins */
+static gboolean manager_loaded = FALSE;
+static gboolean plugins_loaded = FALSE;
+
+/* The plugins are loaded when the plugin manager added them and none of
+ * them waits to be ready anymore (see hd-plugin-ready.c) */
+static void
+check_plugins_loaded (gpointer data)
+{
+  if (plugins_loaded || !manager_loaded || hd_plugin_ready_n_pending ())
+    return;
+
+  plugins_loaded = TRUE;
+
+  hd_metrics_plugin_load_end ();
+  hd_load_order_load_end ();
+
+  /* Record the files used at the next paint */
+  hd_readahead_plugins_loaded ();
+
+  /* Keep the index up to date while running, the preload is done */
+  hd_plugin_index_watch ();
+
+  /* Tell the session, the stamp file only detects crashes */
+  hd_ready_notify (HD_READY_PLUGINS_LOADED);
+}
+
+static void
+stub_plugins_loaded_cb (HDStubPluginManager *manager)
+{
+  manager_loaded = TRUE;
+  check_plugins_loaded (NULL);
+}
+
 static gboolean
 load_plugins_idle (gpointer data)
 {
+  /* The preload stops using the load order */
+  hd_preload_load_begin ();
+
+  hd_metrics_plugin_load_begin ();
+  hd_load_order_load_begin ();
+
+  hd_plugin_ready_set_all_ready_func (check_plugins_loaded, NULL);
 
   /* Load the configuration of the plugin manager and load plugins */
-  hd_plugin_manager_run (HD_PLUGIN_MANAGER (data));
+  if (HD_IS_STUB_PLUGIN_MANAGER (data))
+    /* Scripted plugins may be added later, see stub_plugins_loaded_cb */
+    hd_stub_plugin_manager_run (HD_STUB_PLUGIN_MANAGER (data));
+  else
+    {
+      hd_plugin_manager_run (HD_PLUGIN_MANAGER (data));
+      manager_loaded = TRUE;
+    }
+
+  /* Stop reading ahead the libraries of plugins which were not loaded */
+  hd_preload_finish ();
+
+  check_plugins_loaded (NULL);
+
+  hd_x_audit_end ();
 
   return FALSE;
 }
 
+/* Run with synthetic plugins from a script instead of the installed
+ * plugins (see hd-stub-plugin-manager.c) */
+static GObject *
+create_stub_plugin_manager (const gchar *script)
+{
+  HDStubPluginManager *manager;
+  GError *error = NULL;
+
+  manager = hd_stub_plugin_manager_new ();
+
+  if (!hd_stub_plugin_manager_load_script (manager, script, &error))
+    {
+      g_warning ("%s: could not load plugin script %s. %s",
+                 __FUNCTION__, script, error->message);
+      g_error_free (error);
+    }
+
+  g_signal_connect (manager, "plugins-loaded",
+                    G_CALLBACK (stub_plugins_loaded_cb), NULL);
+
+  return G_OBJECT (manager);
+}
+
 static void
 console_quiet(void)
 {
@@ -110,13 +268,35 @@ int
 main (int argc, char **argv)
 {
   GtkWidget *status_area;
-  HDPluginManager *plugin_manager;
+  GObject *plugin_manager;
+  const gchar *plugin_script;
+
+  /* Startup times of the readiness notifications start here */
+  hd_ready_init ();
+
+  /* Optional per plugin memory accounting, before GLib allocates */
+  hd_metrics_memory_init ();
+
 #if !GLIB_CHECK_VERSION(2,32,0)
   if (!g_thread_supported ())
     g_thread_init (NULL);
 #endif
   setlocale (LC_ALL, "");
 
+  plugin_script = getenv ("HD_STATUS_MENU_PLUGIN_SCRIPT");
+  if (!plugin_script)
+    {
+      /* Read ahead the files used by the startup of previous runs */
+      hd_readahead_init ();
+
+      /* Learn the load times of the installed plugins */
+      hd_load_order_init ();
+
+      /* Read ahead the plugin libraries on worker threads in the meantime,
+       * the index of the plugin directory is loaded there too */
+      hd_preload_start (load_priority_func, NULL);
+    }
+
   /* Initialize Gtk+ */
   gtk_init (&argc, &argv);
 
@@ -127,21 +307,59 @@ main (int argc, char **argv)
   signal (SIGTERM, signal_handler);
   signal (SIGINT, signal_handler);
 
+  /* Dump runtime metrics (including CPU time per plugin) on SIGUSR1 */
+  hd_metrics_init ();
+
+  /* Readiness notifications on the session bus */
+  hd_ready_export ();
+
+  /* Record hot path events, dumped on SIGUSR2 and on crash */
+  hd_recorder_init ();
+
+  /* Optional main loop wakeup summaries */
+  hd_wakeups_init ();
+
+  /* Optional X round-trip accounting, startup ends when the plugins
+   * are loaded */
+  hd_x_audit_init ();
+  hd_x_audit_begin (HD_X_AUDIT_STARTUP);
+
   if (getenv ("DEBUG_OUTPUT") == NULL)
     console_quiet ();
 
   /* Setup Stamp File */
   hd_stamp_file_init (HD_STATUS_MENU_STAMP_FILE);
 
-  /* Create a plugin manager instance */
-  plugin_manager = hd_plugin_manager_new (
-                     hd_config_file_new_with_defaults ("status-menu.conf"));
+  if (plugin_script)
+    plugin_manager = create_stub_plugin_manager (plugin_script);
+  else
+    {
+      /* Create a plugin manager instance */
+      plugin_manager = G_OBJECT (hd_plugin_manager_new (
+                         hd_config_file_new_with_defaults (HD_STATUS_MENU_CONFIG_FILE)));
+
+      /* Set the load priority function */
+      hd_plugin_manager_set_load_priority_func (HD_PLUGIN_MANAGER (plugin_manager),
+                                                load_priority_func,
+                                                NULL,
+                                                NULL);
+    }
+
+  /* Account the construction of each plugin and record plugin changes,
+   * connected before the Status Area and Menu handlers */
+  g_signal_connect (plugin_manager, "plugin-added",
+                    G_CALLBACK (plugin_added_cb), NULL);
+  g_signal_connect_after (plugin_manager, "plugin-added",
+                          G_CALLBACK (plugin_added_after_cb), NULL);
+  g_signal_connect (plugin_manager, "plugin-removed",
+                    G_CALLBACK (plugin_removed_cb), NULL);
+  g_signal_connect_after (plugin_manager, "plugin-removed",
+                          G_CALLBACK (plugin_removed_after_cb), NULL);
+  g_signal_connect (plugin_manager, "items-configuration-loaded",
+                    G_CALLBACK (items_configuration_loaded_cb), NULL);
 
-  /* Set the load priority function */
-  hd_plugin_manager_set_load_priority_func (plugin_manager,
-                                            load_priority_func,
-                                            NULL,
-                                            NULL);
+  /* Record or replay input traces */
+  hd_trace_init (plugin_manager);
 
   /* Create simple window to show the Status Menu 
    */
@@ -0,0 +1,481 @@
+/*
+ * This file is part of hildon-status-menu
+ * 
+ * Copyright (C) 2010 Nokia Corporation.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * version 2.1 as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ */
+
+/* Replays a trace recorded with HD_STATUS_MENU_TRACE (see hd-trace.c)
+ * through the same channels the inputs came from: hildon-status-menu is
+ * run on a Xvfb and a dbus-daemon of its own, as its system and session
+ * bus, so nothing else reaches it while the trace is replayed. At the
+ * time of each event
+ *
+ *   current-app-window   _MB_CURRENT_APP_WINDOW is set on the root window
+ *   mce-display, dsme    the signal is sent on the bus
+ *   icon                 replayed in the process on the plugin manager
+ *                        stand-in, see HD_STATUS_MENU_REPLAY
+ *
+ * The times are from the map of the first window of hildon-status-menu,
+ * the Status Area, which is right after the trace starts in the process
+ * (see hd_trace_init). After the last
+ * event it is stopped, unless the trace ends with a DSME shutdown_ind
+ * which it exits on by itself. Needs Xvfb and dbus-daemon in the PATH.
+ *
+ *   replay-trace trace [plugin script [hildon-status-menu binary]] */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <glib.h>
+
+#include <X11/Xlib.h>
+#include <X11/Xatom.h>
+
+#include <dbus/dbus.h>
+
+#include <mce/dbus-names.h>
+
+#include <errno.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "hd-trace.h"
+
+#define DEFAULT_BINARY "./hildon-status-menu"
+
+/* As in hd-status-menu.c */
+#define DSME_SIGNAL_PATH      "/com/nokia/dsme/signal"
+#define DSME_SIGNAL_INTERFACE "com.nokia.dsme.signal"
+
+#define FIRST_DISPLAY 90
+#define N_DISPLAYS    100
+
+/* Times in microseconds */
+#define START_TIMEOUT (10 * G_USEC_PER_SEC)
+#define SETTLE_TIME   (2 * G_USEC_PER_SEC)
+#define EXIT_TIMEOUT  (5 * G_USEC_PER_SEC)
+
+typedef struct _Event Event;
+struct _Event
+{
+  guint  time;
+  gchar *event;
+  gchar *arg;
+};
+
+static guint64
+get_time (void)
+{
+  struct timespec ts;
+
+  clock_gettime (CLOCK_MONOTONIC, &ts);
+
+  return (guint64) ts.tv_sec * G_USEC_PER_SEC + ts.tv_nsec / 1000;
+}
+
+static void
+stop_process (GPid pid)
+{
+  kill (pid, SIGTERM);
+  waitpid (pid, NULL, 0);
+  g_spawn_close_pid (pid);
+}
+
+/* Same format as load_replay in hd-trace.c */
+static GPtrArray *
+load_trace (const gchar *filename)
+{
+  GPtrArray *events;
+  gchar *contents;
+  gchar **lines;
+  GError *error = NULL;
+  guint i;
+
+  if (!g_file_get_contents (filename, &contents, NULL, &error))
+    {
+      g_printerr ("Could not load trace %s. %s\n", filename, error->message);
+      g_error_free (error);
+      return NULL;
+    }
+
+  events = g_ptr_array_new ();
+
+  lines = g_strsplit (contents, "\n", -1);
+  for (i = 0; lines[i]; i++)
+    {
+      gchar **fields;
+
+      if (!*lines[i])
+        continue;
+
+      fields = g_strsplit (lines[i], " ", 3);
+      if (g_strv_length (fields) == 3)
+        {
+          Event *event = g_new (Event, 1);
+
+          event->time = strtoul (fields[0], NULL, 10);
+          event->event = g_strdup (fields[1]);
+          event->arg = g_strdup (fields[2]);
+
+          g_ptr_array_add (events, event);
+        }
+      else
+        g_printerr ("Invalid line %u in trace %s\n", i + 1, filename);
+
+      g_strfreev (fields);
+    }
+
+  g_strfreev (lines);
+  g_free (contents);
+
+  return events;
+}
+
+/* Starts a private dbus-daemon, returns its address */
+static gchar *
+start_bus (GPid *pid)
+{
+  gchar *argv[] = { "dbus-daemon", "--session", "--nofork",
+                    "--print-address=1", NULL };
+  GIOChannel *channel;
+  gchar *address = NULL;
+  gint out;
+
+  if (!g_spawn_async_with_pipes (NULL, argv, NULL,
+                                 G_SPAWN_SEARCH_PATH | G_SPAWN_DO_NOT_REAP_CHILD,
+                                 NULL, NULL, pid, NULL, &out, NULL,
+                                 NULL))
+    return NULL;
+
+  channel = g_io_channel_unix_new (out);
+  g_io_channel_read_line (channel, &address, NULL, NULL, NULL);
+  g_io_channel_shutdown (channel, FALSE, NULL);
+  g_io_channel_unref (channel);
+
+  if (address)
+    g_strchomp (address);
+  else
+    stop_process (*pid);
+
+  return address;
+}
+
+/* Starts a Xvfb on the first free display and connects to it */
+static GPid
+start_xvfb (Display **display)
+{
+  guint n;
+
+  for (n = FIRST_DISPLAY; n < FIRST_DISPLAY + N_DISPLAYS; n++)
+    {
+      gchar *lock, *name;
+      gchar *argv[] = { "Xvfb", NULL, "-screen", "0", "800x480x24",
+                        "-nolisten", "tcp", NULL };
+      GPid pid;
+      guint64 deadline;
+      GError *error = NULL;
+
+      lock = g_strdup_printf ("/tmp/.X%u-lock", n);
+      if (g_file_test (lock, G_FILE_TEST_EXISTS))
+        {
+          g_free (lock);
+          continue;
+        }
+      g_free (lock);
+
+      name = g_strdup_printf (":%u", n);
+      argv[1] = name;
+
+      if (!g_spawn_async (NULL, argv, NULL,
+                          G_SPAWN_SEARCH_PATH | G_SPAWN_DO_NOT_REAP_CHILD |
+                          G_SPAWN_STDOUT_TO_DEV_NULL |
+                          G_SPAWN_STDERR_TO_DEV_NULL,
+                          NULL, NULL, &pid, &error))
+        {
+          g_printerr ("Could not start Xvfb. %s\n", error->message);
+          g_error_free (error);
+          g_free (name);
+          return 0;
+        }
+
+      deadline = get_time () + START_TIMEOUT;
+      *display = NULL;
+
+      /* Xvfb exits if another server took the display meanwhile */
+      while (!*display && get_time () < deadline &&
+             waitpid (pid, NULL, WNOHANG) == 0)
+        {
+          *display = XOpenDisplay (name);
+          if (!*display)
+            g_usleep (50 * 1000);
+        }
+
+      if (*display)
+        g_setenv ("DISPLAY", name, TRUE);
+      else
+        stop_process (pid);
+
+      g_free (name);
+
+      if (*display)
+        return pid;
+    }
+
+  g_printerr ("Could not start Xvfb on a free display\n");
+
+  return 0;
+}
+
+static void
+send_signal (DBusConnection *bus,
+             const gchar    *path,
+             const gchar    *interface,
+             const gchar    *name,
+             const gchar    *arg)
+{
+  DBusMessage *message;
+
+  message = dbus_message_new_signal (path, interface, name);
+  if (arg)
+    dbus_message_append_args (message,
+                              DBUS_TYPE_STRING, &arg,
+                              DBUS_TYPE_INVALID);
+  dbus_connection_send (bus, message, NULL);
+  dbus_connection_flush (bus);
+  dbus_message_unref (message);
+}
+
+static void
+replay_event (Display        *display,
+              DBusConnection *bus,
+              Event          *event)
+{
+  if (!strcmp (event->event, HD_TRACE_CURRENT_APP_WINDOW))
+    {
+      /* Format 32 data is passed as longs */
+      long window = strtoul (event->arg, NULL, 10);
+
+      XChangeProperty (display, DefaultRootWindow (display),
+                       XInternAtom (display, "_MB_CURRENT_APP_WINDOW", False),
+                       XA_WINDOW, 32, PropModeReplace,
+                       (unsigned char *) &window, 1);
+      XFlush (display);
+    }
+  else if (!strcmp (event->event, HD_TRACE_MCE_DISPLAY))
+    send_signal (bus, MCE_SIGNAL_PATH, MCE_SIGNAL_IF, MCE_DISPLAY_SIG,
+                 event->arg);
+  else if (!strcmp (event->event, HD_TRACE_DSME))
+    send_signal (bus, DSME_SIGNAL_PATH, DSME_SIGNAL_INTERFACE, event->arg,
+                 NULL);
+  else if (strcmp (event->event, HD_TRACE_ICON))
+    g_printerr ("Unknown event %s\n", event->event);
+}
+
+/* Waits for the first window of the process to be mapped until
+ * @deadline, returns %FALSE if it was not */
+static gboolean
+wait_map (Display *display,
+          guint64  deadline)
+{
+  XEvent event;
+
+  while (TRUE)
+    {
+      while (XPending (display))
+        {
+          XNextEvent (display, &event);
+          if (event.type == MapNotify)
+            return TRUE;
+        }
+
+      while (!XPending (display))
+        {
+          struct pollfd pfd;
+          guint64 now = get_time ();
+
+          if (now >= deadline)
+            return FALSE;
+
+          pfd.fd = ConnectionNumber (display);
+          pfd.events = POLLIN;
+          pfd.revents = 0;
+
+          if (poll (&pfd, 1, (deadline - now + 999) / 1000) < 0 && errno != EINTR)
+            return FALSE;
+        }
+    }
+}
+
+/* Waits for the process to exit until @deadline, returns %FALSE if it
+ * did not */
+static gboolean
+wait_exit (GPid     pid,
+           guint64  deadline,
+           int     *status)
+{
+  while (waitpid (pid, status, WNOHANG) == 0)
+    {
+      if (get_time () >= deadline)
+        return FALSE;
+
+      g_usleep (10 * 1000);
+    }
+
+  g_spawn_close_pid (pid);
+
+  return TRUE;
+}
+
+int
+main (int argc, char **argv)
+{
+  const gchar *binary = DEFAULT_BINARY;
+  gchar *child_argv[] = { NULL, NULL };
+  GPtrArray *events;
+  Display *display = NULL;
+  DBusConnection *bus = NULL;
+  GPid xvfb, dbus_daemon, status_menu = 0;
+  gchar *address;
+  guint64 start, late = 0;
+  gboolean exited = FALSE;
+  int status = 0;
+  int result = EXIT_FAILURE;
+  guint i;
+  GError *error = NULL;
+
+  if (argc < 2)
+    {
+      g_printerr ("Usage: %s trace [plugin script [hildon-status-menu binary]]\n",
+                  argv[0]);
+      return EXIT_FAILURE;
+    }
+  if (argc > 3)
+    binary = argv[3];
+
+  events = load_trace (argv[1]);
+  if (!events)
+    return EXIT_FAILURE;
+
+  xvfb = start_xvfb (&display);
+  if (!xvfb)
+    return EXIT_FAILURE;
+
+  address = start_bus (&dbus_daemon);
+  if (!address)
+    {
+      g_printerr ("Could not start dbus-daemon\n");
+      goto out_xvfb;
+    }
+
+  /* The private bus is the system and the session bus of the process */
+  g_setenv ("DBUS_SYSTEM_BUS_ADDRESS", address, TRUE);
+  g_setenv ("DBUS_SESSION_BUS_ADDRESS", address, TRUE);
+
+  bus = dbus_connection_open_private (address, NULL);
+  if (!bus || !dbus_bus_register (bus, NULL))
+    {
+      g_printerr ("Could not connect to %s\n", address);
+      goto out_bus;
+    }
+
+  /* The icon changes are replayed in the process */
+  g_setenv ("HD_STATUS_MENU_REPLAY", argv[1], TRUE);
+  if (argc > 2)
+    g_setenv ("HD_STATUS_MENU_PLUGIN_SCRIPT", argv[2], TRUE);
+
+  XSelectInput (display, DefaultRootWindow (display), SubstructureNotifyMask);
+  XSync (display, False);
+
+  child_argv[0] = (gchar *) binary;
+  if (!g_spawn_async (NULL, child_argv, NULL, G_SPAWN_DO_NOT_REAP_CHILD,
+                      NULL, NULL, &status_menu, &error))
+    {
+      g_printerr ("Could not start %s. %s\n", binary, error->message);
+      g_error_free (error);
+      status_menu = 0;
+      goto out_bus;
+    }
+
+  if (!wait_map (display, get_time () + START_TIMEOUT))
+    {
+      g_printerr ("The Status Area was not shown\n");
+      stop_process (status_menu);
+      goto out_bus;
+    }
+
+  /* Only the root window events were wanted */
+  XSelectInput (display, DefaultRootWindow (display), NoEventMask);
+
+  start = get_time ();
+
+  for (i = 0; i < events->len && !exited; i++)
+    {
+      Event *event = g_ptr_array_index (events, i);
+      guint64 due = start + (guint64) event->time * 1000;
+
+      exited = wait_exit (status_menu, due, &status);
+      if (exited)
+        break;
+
+      late = MAX (late, get_time () - due);
+
+      replay_event (display, bus, event);
+    }
+
+  if (!exited)
+    exited = wait_exit (status_menu, get_time () + SETTLE_TIME, &status);
+
+  if (exited)
+    g_print ("%s exited with status %d after %u of %u events\n",
+             binary, WIFEXITED (status) ? WEXITSTATUS (status) : -1,
+             i, events->len);
+  else
+    {
+      g_print ("Replayed %u events, at most %" G_GUINT64_FORMAT " us late\n",
+               events->len, late);
+      kill (status_menu, SIGTERM);
+      if (!wait_exit (status_menu, get_time () + EXIT_TIMEOUT, &status))
+        {
+          g_printerr ("%s did not exit\n", binary);
+          stop_process (status_menu);
+        }
+    }
+
+  result = EXIT_SUCCESS;
+
+out_bus:
+  if (bus)
+    {
+      dbus_connection_close (bus);
+      dbus_connection_unref (bus);
+    }
+  stop_process (dbus_daemon);
+  g_free (address);
+
+out_xvfb:
+  XCloseDisplay (display);
+  stop_process (xvfb);
+
+  return result;
+}
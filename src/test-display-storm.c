@@ -0,0 +1,442 @@
+/*
+ * This file is part of hildon-status-menu
+ * 
+ * Copyright (C) 2010 Nokia Corporation.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * version 2.1 as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ */
+
+/* Sends storms of MCE display_status_ind signals, mixed with DSME
+ * signals, on a private bus to a Status Area and checks the state they
+ * leave (see display_status_changed_cb in hd-status-area.c): repeated or
+ * dimmed states do not change the visibility at all and after a burst of
+ * on/off changes a plugin sees the status of the last one. Prints the
+ * throughput of the bus filters, the time until the last signal is
+ * applied and the CPU time used per signal. Finally a DSME shutdown_ind
+ * sent after a storm has to stop the process (see hd-status-menu.c).
+ *
+ * Needs an X display (e.g. run with xvfb-run) and dbus-daemon, the test
+ * is skipped without them. */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <hildon/hildon.h>
+
+#include <dbus/dbus.h>
+#include <dbus/dbus-glib-lowlevel.h>
+
+#include <mce/dbus-names.h>
+#include <mce/mode-names.h>
+
+#include <signal.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "hd-display.h"
+#include "hd-metrics.h"
+#include "hd-status-area.h"
+#include "hd-stub-plugin-manager.h"
+
+/* As in hd-status-menu.c */
+#define DSME_SIGNAL_INTERFACE "com.nokia.dsme.signal"
+#define DSME_SHUTDOWN_SIGNAL_NAME "shutdown_ind"
+/* A DSME signal which is not acted on */
+#define DSME_SAVE_DATA_SIGNAL_NAME "save_unsaved_data_ind"
+
+/* Exit status of skipped tests for the automake test driver */
+#define EXIT_SKIP 77
+
+/* Signals per storm, kept below what fits in the socket buffers so the
+ * bus delivers each storm in one go */
+#define N_SIGNALS 500
+
+/* Seconds to wait for the signals of a storm */
+#define TIMEOUT 10
+
+static GPid bus_pid = 0;
+
+/* The only plugin, it is told whether the Status Area is visible */
+static GObject *plugin = NULL;
+
+/* Starts a private dbus-daemon, returns its address */
+static gchar *
+start_bus (void)
+{
+  gchar *argv[] = { "dbus-daemon", "--session", "--nofork",
+                    "--print-address=1", NULL };
+  GIOChannel *channel;
+  gchar *address = NULL;
+  gint out;
+
+  if (!g_spawn_async_with_pipes (NULL, argv, NULL, G_SPAWN_SEARCH_PATH,
+                                 NULL, NULL, &bus_pid, NULL, &out, NULL,
+                                 NULL))
+    return NULL;
+
+  channel = g_io_channel_unix_new (out);
+  g_io_channel_read_line (channel, &address, NULL, NULL, NULL);
+  g_io_channel_shutdown (channel, FALSE, NULL);
+  g_io_channel_unref (channel);
+
+  if (address)
+    g_strchomp (address);
+
+  return address;
+}
+
+static void
+stop_bus (void)
+{
+  if (bus_pid)
+    {
+      kill (bus_pid, SIGTERM);
+      g_spawn_close_pid (bus_pid);
+      bus_pid = 0;
+    }
+}
+
+static void
+send_dsme_signal (DBusConnection *connection,
+                  const gchar    *name)
+{
+  DBusMessage *message;
+
+  message = dbus_message_new_signal ("/com/nokia/dsme/signal",
+                                     DSME_SIGNAL_INTERFACE,
+                                     name);
+  dbus_connection_send (connection, message, NULL);
+  dbus_message_unref (message);
+}
+
+static void
+send_display_status (DBusConnection *connection,
+                     const gchar    *status)
+{
+  DBusMessage *message;
+
+  message = dbus_message_new_signal (MCE_SIGNAL_PATH,
+                                     MCE_SIGNAL_IF,
+                                     MCE_DISPLAY_SIG);
+  dbus_message_append_args (message,
+                            DBUS_TYPE_STRING, &status,
+                            DBUS_TYPE_INVALID);
+  dbus_connection_send (connection, message, NULL);
+  dbus_message_unref (message);
+}
+
+/* Round-trip to the bus daemon, it routed all signals sent before once it
+ * replies */
+static void
+sync_bus (DBusConnection *connection)
+{
+  DBusMessage *message, *reply;
+
+  message = dbus_message_new_method_call (DBUS_SERVICE_DBUS,
+                                          DBUS_PATH_DBUS,
+                                          DBUS_INTERFACE_DBUS,
+                                          "GetId");
+  reply = dbus_connection_send_with_reply_and_block (connection, message,
+                                                     -1, NULL);
+  dbus_message_unref (message);
+
+  if (reply)
+    dbus_message_unref (reply);
+}
+
+static gboolean
+wakeup_cb (gpointer data)
+{
+  return TRUE;
+}
+
+/* Runs the main loop until nothing is pending anymore */
+static void
+drain (void)
+{
+  while (g_main_context_pending (NULL))
+    g_main_context_iteration (NULL, FALSE);
+}
+
+/* Runs the main loop for some time, for the X events to arrive */
+static void
+settle (gdouble seconds)
+{
+  GTimer *timer;
+
+  timer = g_timer_new ();
+  while (g_timer_elapsed (timer, NULL) < seconds)
+    g_main_context_iteration (NULL, TRUE);
+  g_timer_destroy (timer);
+
+  drain ();
+}
+
+/* Sends n display status signals cycling through statuses, each followed
+ * by a DSME signal if dsme is set, and waits until they are applied.
+ * Returns FALSE if they did not arrive in time. */
+static gboolean
+run_storm (DBusConnection  *sender,
+           const gchar     *name,
+           const gchar    **statuses,
+           guint            n,
+           gboolean         dsme)
+{
+  guint64 messages, updates, filter_cpu, start, cpu_start, elapsed, cpu;
+  guint i, n_statuses, n_messages;
+
+  drain ();
+
+  messages = hd_metrics_counter_get (HD_METRICS_DBUS_MESSAGES);
+  updates = hd_metrics_counter_get (HD_METRICS_VISIBILITY_UPDATES);
+  filter_cpu = hd_metrics_counter_get (HD_METRICS_DBUS_FILTER_CPU);
+
+  n_statuses = g_strv_length ((gchar **) statuses);
+  for (i = 0; i < n; i++)
+    {
+      send_display_status (sender, statuses[i % n_statuses]);
+      if (dsme)
+        send_dsme_signal (sender, DSME_SAVE_DATA_SIGNAL_NAME);
+    }
+  n_messages = dsme ? 2 * n : n;
+
+  start = hd_metrics_get_time ();
+  cpu_start = hd_metrics_get_cpu_time ();
+
+  dbus_connection_flush (sender);
+  sync_bus (sender);
+
+  while (hd_metrics_counter_get (HD_METRICS_DBUS_MESSAGES) < messages + n_messages &&
+         hd_metrics_get_time () - start < TIMEOUT * G_USEC_PER_SEC)
+    g_main_context_iteration (NULL, TRUE);
+
+  if (hd_metrics_counter_get (HD_METRICS_DBUS_MESSAGES) < messages + n_messages)
+    {
+      g_print ("%-10s %" G_GUINT64_FORMAT " of %u signals arrived\n", name,
+               hd_metrics_counter_get (HD_METRICS_DBUS_MESSAGES) - messages,
+               n_messages);
+      return FALSE;
+    }
+
+  /* Until the visibility of the last status is applied */
+  drain ();
+
+  elapsed = MAX (hd_metrics_get_time () - start, 1);
+  cpu = hd_metrics_get_cpu_time () - cpu_start;
+
+  g_print ("%-10s %5u signals %5" G_GUINT64_FORMAT " visibility updates, "
+           "%7" G_GUINT64_FORMAT " signals/s filtered, "
+           "%6" G_GUINT64_FORMAT " us until applied, "
+           "%5.1f us CPU (%4.1f us filters) per signal\n",
+           name, n_messages,
+           hd_metrics_counter_get (HD_METRICS_VISIBILITY_UPDATES) - updates,
+           (guint64) n_messages * G_USEC_PER_SEC / elapsed,
+           elapsed,
+           (gdouble) cpu / n_messages,
+           (gdouble) (hd_metrics_counter_get (HD_METRICS_DBUS_FILTER_CPU) - filter_cpu) / n_messages);
+
+  return TRUE;
+}
+
+static gboolean
+is_plugin_told_visible (void)
+{
+  gboolean visible;
+
+  g_object_get (plugin, "status-area-visible", &visible, NULL);
+
+  return visible;
+}
+
+/* Checks the state a storm leaves: the display status of the last signal,
+ * which the plugin was told, and the visibility changed only if the
+ * storm can change it (the counts of updates and changes in between
+ * depend on how the bus delivers the storm) */
+static gboolean
+check_storm (DBusConnection  *sender,
+             const gchar     *name,
+             const gchar    **statuses,
+             gboolean         dsme,
+             gboolean         can_change)
+{
+  HDDisplay *display;
+  guint64 changes;
+  gboolean on, ok = TRUE;
+  guint n_statuses;
+
+  changes = hd_metrics_counter_get (HD_METRICS_VISIBILITY_CHANGES);
+
+  if (!run_storm (sender, name, statuses, N_SIGNALS, dsme))
+    return FALSE;
+
+  n_statuses = g_strv_length ((gchar **) statuses);
+  on = strcmp (statuses[(N_SIGNALS - 1) % n_statuses],
+               MCE_DISPLAY_OFF_STRING) != 0;
+
+  display = hd_display_get ();
+  if (hd_display_is_on (display) != on)
+    {
+      g_print ("%-10s display %s after the last signal\n",
+               name, on ? "off" : "on");
+      ok = FALSE;
+    }
+  g_object_unref (display);
+
+  if (is_plugin_told_visible () != on)
+    {
+      g_print ("%-10s plugin told the Status Area is %s\n",
+               name, on ? "hidden" : "visible");
+      ok = FALSE;
+    }
+
+  if (!can_change &&
+      hd_metrics_counter_get (HD_METRICS_VISIBILITY_CHANGES) != changes)
+    {
+      g_print ("%-10s visibility changed\n", name);
+      ok = FALSE;
+    }
+
+  return ok;
+}
+
+static void
+plugin_added_cb (GObject *plugin_manager,
+                 GObject *added)
+{
+  plugin = added;
+}
+
+static gboolean
+shutdown_timeout_cb (gpointer data)
+{
+  g_print ("Still running after %s\n", DSME_SHUTDOWN_SIGNAL_NAME);
+  exit (EXIT_FAILURE);
+
+  return FALSE;
+}
+
+int
+main (int argc, char **argv)
+{
+  static const gchar *repeated[] = { MCE_DISPLAY_ON_STRING, NULL };
+  static const gchar *dimming[] = { MCE_DISPLAY_DIM_STRING,
+                                    MCE_DISPLAY_ON_STRING, NULL };
+  static const gchar *flipping[] = { MCE_DISPLAY_OFF_STRING,
+                                     MCE_DISPLAY_ON_STRING, NULL };
+  static const gchar *flipping_off[] = { MCE_DISPLAY_ON_STRING,
+                                         MCE_DISPLAY_OFF_STRING, NULL };
+  DBusConnection *sender, *system_bus;
+  GtkWidget *status_area;
+  HDStubPluginManager *plugin_manager;
+  gchar *address;
+  GError *error = NULL;
+  gboolean passed = TRUE;
+
+#if !GLIB_CHECK_VERSION(2,32,0)
+  if (!g_thread_supported ())
+    g_thread_init (NULL);
+#endif
+
+  if (!gtk_init_check (&argc, &argv))
+    {
+      g_print ("No X display, skipped\n");
+      return EXIT_SKIP;
+    }
+  hildon_init ();
+
+  address = start_bus ();
+  if (!address)
+    {
+      g_print ("Could not start dbus-daemon, skipped\n");
+      return EXIT_SKIP;
+    }
+
+  /* Stops the bus when shutdown_ind stops the process */
+  atexit (stop_bus);
+
+  /* Keep the Status Area and Menu off the buses of the session */
+  g_setenv ("DBUS_SYSTEM_BUS_ADDRESS", address, TRUE);
+  g_setenv ("DBUS_SESSION_BUS_ADDRESS", address, TRUE);
+
+  /* As done by the libraries of the plugins in the real process */
+  system_bus = dbus_bus_get (DBUS_BUS_SYSTEM, NULL);
+  if (!system_bus)
+    {
+      g_print ("Could not connect to %s\n", address);
+      stop_bus ();
+      return EXIT_FAILURE;
+    }
+  dbus_connection_setup_with_g_main (system_bus, NULL);
+
+  sender = dbus_connection_open_private (address, NULL);
+  if (!sender || !dbus_bus_register (sender, NULL))
+    {
+      g_print ("Could not connect to %s\n", address);
+      stop_bus ();
+      return EXIT_FAILURE;
+    }
+
+  plugin_manager = hd_stub_plugin_manager_new ();
+  if (!hd_stub_plugin_manager_load_data (plugin_manager,
+                                         "[area.desktop]\n"
+                                         "X-Stub-Icon=general_add\n",
+                                         &error))
+    {
+      g_print ("Could not load the plugin script. %s\n", error->message);
+      g_error_free (error);
+      return EXIT_FAILURE;
+    }
+  g_signal_connect (plugin_manager, "plugin-added",
+                    G_CALLBACK (plugin_added_cb), NULL);
+
+  /* Also creates the Status Menu, which listens to DSME */
+  status_area = hd_status_area_new (G_OBJECT (plugin_manager));
+  gtk_widget_show (status_area);
+  hd_stub_plugin_manager_run (plugin_manager);
+
+  /* Wakes up the blocking main loop iterations */
+  g_timeout_add (10, wakeup_cb, NULL);
+
+  /* Let the map and configure events settle */
+  settle (0.5);
+
+  if (!plugin)
+    {
+      g_print ("Plugin not added\n");
+      return EXIT_FAILURE;
+    }
+
+  passed &= check_storm (sender, "repeated", repeated, FALSE, FALSE);
+  passed &= check_storm (sender, "dimming", dimming, FALSE, FALSE);
+  passed &= check_storm (sender, "flipping", flipping, FALSE, TRUE);
+  passed &= check_storm (sender, "dsme", flipping, TRUE, TRUE);
+  passed &= check_storm (sender, "off", flipping_off, FALSE, TRUE);
+  passed &= check_storm (sender, "on", flipping, TRUE, TRUE);
+
+  if (!passed)
+    return EXIT_FAILURE;
+
+  /* The Status Menu exits on shutdown_ind, also right after a storm */
+  run_storm (sender, "shutdown", flipping, N_SIGNALS, TRUE);
+  send_dsme_signal (sender, DSME_SHUTDOWN_SIGNAL_NAME);
+  dbus_connection_flush (sender);
+
+  g_timeout_add_seconds (TIMEOUT, shutdown_timeout_cb, NULL);
+  gtk_main ();
+
+  return EXIT_FAILURE;
+}
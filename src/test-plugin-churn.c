@@ -0,0 +1,275 @@
+/*
+ * This file is part of hildon-status-menu
+ * 
+ * Copyright (C) 2010 Nokia Corporation.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * version 2.1 as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ */
+
+/* Drives a Status Area and Status Menu through add and remove cycles of
+ * synthetic plugins (see hd-stub-plugin-manager.c) and fails if
+ *
+ *   - a removed plugin is not finalized (weak references on each plugin
+ *     added), e.g. because it is still referenced
+ *   - the icon images or menu items alive do not return to where they
+ *     started
+ *   - the malloc heap (with GSlice allocating from malloc) or the
+ *     resident set grow by more than a bound after some warm-up cycles
+ *
+ * and prints the time per cycle.
+ *
+ * Needs an X display (e.g. run with xvfb-run), the test is skipped
+ * without it. */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <hildon/hildon.h>
+
+#include <stdlib.h>
+
+#include "hd-metrics.h"
+#include "hd-status-area.h"
+#include "hd-status-menu.h"
+#include "hd-status-menu-config.h"
+#include "hd-stub-plugin-manager.h"
+
+/* Exit status of skipped tests for the automake test driver */
+#define EXIT_SKIP 77
+
+#define N_CYCLES        200
+#define N_WARMUP_CYCLES 20
+#define N_AREA_PLUGINS  8
+#define N_MENU_PLUGINS  8
+
+/* Growth allowed after the warm-up cycles, in bytes */
+#define MAX_HEAP_GROWTH (256 * 1024)
+#define MAX_RSS_GROWTH  (1024 * 1024)
+
+/* Plugins added and not finalized yet */
+static guint n_live_plugins = 0;
+
+static void
+plugin_finalized_cb (gpointer  data,
+                     GObject  *plugin)
+{
+  n_live_plugins--;
+}
+
+static void
+plugin_added_cb (GObject *plugin_manager,
+                 GObject *plugin)
+{
+  n_live_plugins++;
+  g_object_weak_ref (plugin, plugin_finalized_cb, NULL);
+}
+
+/* The clock, Status Area plugins with icons, one of them using a special
+ * item, and Status Menu items */
+static gchar *
+create_script (void)
+{
+  GString *script;
+  guint i;
+
+  script = g_string_new (NULL);
+
+  g_string_append (script,
+                   "[clock.desktop]\n"
+                   HD_STATUS_AREA_CONFIG_KEY_PERMANENT_ITEM "="
+                   HD_STATUS_AREA_CONFIG_VALUE_CLOCK "\n");
+
+  for (i = 0; i < N_AREA_PLUGINS; i++)
+    {
+      g_string_append_printf (script,
+                              "[area-%u.desktop]\n"
+                              HD_STATUS_AREA_CONFIG_KEY_POSITION "=%u\n"
+                              "X-Stub-Icon=general_add\n",
+                              i, i);
+      if (i == 0)
+        g_string_append_printf (script,
+                                HD_STATUS_AREA_CONFIG_KEY_PERMANENT_ITEM "="
+                                HD_STATUS_AREA_CONFIG_VALUE_SPECIAL_ITEM "\n",
+                                0);
+    }
+
+  for (i = 0; i < N_MENU_PLUGINS; i++)
+    g_string_append_printf (script,
+                            "[menu-%u.desktop]\n"
+                            HD_STATUS_MENU_CONFIG_KEY_POSITION "=%u\n"
+                            "X-Stub-Type=status-menu\n",
+                            i, i);
+
+  return g_string_free (script, FALSE);
+}
+
+/* Runs the main loop until nothing is pending anymore. The hidden Status
+ * Menu does not process its resizes, it is laid out as on a tap on the
+ * Status Area to update its items gauge. */
+static void
+drain (void)
+{
+  GList *toplevels, *l;
+
+  while (g_main_context_pending (NULL))
+    g_main_context_iteration (NULL, FALSE);
+
+  toplevels = gtk_window_list_toplevels ();
+  for (l = toplevels; l; l = l->next)
+    if (HD_IS_STATUS_MENU (l->data))
+      {
+        hd_status_menu_prepare (l->data);
+        hd_status_menu_unprepare (l->data);
+      }
+  g_list_free (toplevels);
+}
+
+int
+main (int argc, char **argv)
+{
+  HDStubPluginManager *plugin_manager;
+  GtkWidget *status_area;
+  guint64 images, items;
+  guint64 cycle_time, total_time = 0, max_time = 0;
+  guint64 rss = 0;
+  gsize heap = 0;
+  gchar *script;
+  GError *error = NULL;
+  gboolean passed = TRUE;
+  guint i;
+
+  /* GSlice blocks are then seen in the malloc heap */
+  g_setenv ("G_SLICE", "always-malloc", TRUE);
+
+#if !GLIB_CHECK_VERSION(2,32,0)
+  if (!g_thread_supported ())
+    g_thread_init (NULL);
+#endif
+
+  if (!gtk_init_check (&argc, &argv))
+    {
+      g_print ("No X display, skipped\n");
+      return EXIT_SKIP;
+    }
+  hildon_init ();
+
+  plugin_manager = hd_stub_plugin_manager_new ();
+
+  script = create_script ();
+  if (!hd_stub_plugin_manager_load_data (plugin_manager, script, &error))
+    {
+      g_print ("Could not load the plugin script. %s\n", error->message);
+      g_error_free (error);
+      return EXIT_FAILURE;
+    }
+  g_free (script);
+
+  g_signal_connect (plugin_manager, "plugin-added",
+                    G_CALLBACK (plugin_added_cb), NULL);
+
+  status_area = hd_status_area_new (G_OBJECT (plugin_manager));
+  gtk_widget_show (status_area);
+  drain ();
+
+  images = hd_metrics_counter_get (HD_METRICS_AREA_IMAGES);
+  items = hd_metrics_counter_get (HD_METRICS_MENU_ITEMS);
+
+  /* Adds all plugins of the script */
+  hd_stub_plugin_manager_run (plugin_manager);
+  drain ();
+
+  /* The special item image is owned by the Status Area */
+  if (n_live_plugins != 1 + N_AREA_PLUGINS + N_MENU_PLUGINS ||
+      hd_metrics_counter_get (HD_METRICS_AREA_IMAGES) != images + N_AREA_PLUGINS - 1 ||
+      hd_metrics_counter_get (HD_METRICS_MENU_ITEMS) != items + N_MENU_PLUGINS)
+    {
+      g_print ("Plugins not added: %" G_GUINT64_FORMAT " images, %"
+               G_GUINT64_FORMAT " menu items\n",
+               hd_metrics_counter_get (HD_METRICS_AREA_IMAGES),
+               hd_metrics_counter_get (HD_METRICS_MENU_ITEMS));
+      passed = FALSE;
+    }
+
+  for (i = 0; i < N_CYCLES && passed; i++)
+    {
+      guint64 start = hd_metrics_get_time ();
+
+      if (i == N_WARMUP_CYCLES)
+        {
+          heap = hd_metrics_get_heap_in_use ();
+          rss = hd_metrics_get_rss ();
+        }
+
+      hd_stub_plugin_manager_remove_plugins (plugin_manager);
+      drain ();
+
+      if (n_live_plugins)
+        {
+          g_print ("Cycle %u: %u removed plugins not finalized\n",
+                   i, n_live_plugins);
+          passed = FALSE;
+        }
+
+      if (hd_metrics_counter_get (HD_METRICS_AREA_IMAGES) != images ||
+          hd_metrics_counter_get (HD_METRICS_MENU_ITEMS) != items)
+        {
+          g_print ("Cycle %u: %" G_GUINT64_FORMAT " images (baseline %"
+                   G_GUINT64_FORMAT "), %" G_GUINT64_FORMAT
+                   " menu items (baseline %" G_GUINT64_FORMAT ")\n",
+                   i,
+                   hd_metrics_counter_get (HD_METRICS_AREA_IMAGES), images,
+                   hd_metrics_counter_get (HD_METRICS_MENU_ITEMS), items);
+          passed = FALSE;
+        }
+
+      hd_stub_plugin_manager_add_plugins (plugin_manager);
+      drain ();
+
+      cycle_time = hd_metrics_get_time () - start;
+      total_time += cycle_time;
+      max_time = MAX (max_time, cycle_time);
+    }
+
+  /* 0 if unknown on this system */
+  if (passed && heap && hd_metrics_get_heap_in_use () > heap + MAX_HEAP_GROWTH)
+    {
+      g_print ("Heap grew by %" G_GSIZE_FORMAT " bytes in %u cycles\n",
+               hd_metrics_get_heap_in_use () - heap, N_CYCLES - N_WARMUP_CYCLES);
+      passed = FALSE;
+    }
+
+  if (passed && rss && hd_metrics_get_rss () > rss + MAX_RSS_GROWTH)
+    {
+      g_print ("Resident set grew by %" G_GUINT64_FORMAT " bytes in %u cycles\n",
+               hd_metrics_get_rss () - rss, N_CYCLES - N_WARMUP_CYCLES);
+      passed = FALSE;
+    }
+
+  if (i > 0)
+    g_print ("%u cycles of %u plugins, %" G_GUINT64_FORMAT " us per cycle (max %"
+             G_GUINT64_FORMAT " us)\n",
+             i, 1 + N_AREA_PLUGINS + N_MENU_PLUGINS, total_time / i, max_time);
+
+  if (passed)
+    g_print ("Plugins finalized, images, menu items, heap and resident set "
+             "back to baseline\n");
+
+  gtk_widget_destroy (status_area);
+  g_object_unref (plugin_manager);
+
+  return passed ? EXIT_SUCCESS : EXIT_FAILURE;
+}